@@ -0,0 +1,87 @@
+//
+// Created by Trebing, Peter on 2019-09-21.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "benchmark.h"
+
+void Benchmark::run(const std::string &kernel, const std::string &distribution, std::size_t n, std::size_t ops,
+                    const std::function<void()> &reset, const std::function<double()> &f) {
+
+    if (!filter.empty() && kernel.find(filter) == std::string::npos) return;
+
+    // warm up caches and calibrate the number of calls per repetition
+    reset();
+    auto start = std::chrono::steady_clock::now();
+    double checksum = f();
+    double warmupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::size_t calls = warmupMs >= minRepetitionMs ? 1 :
+                        static_cast<std::size_t>(std::ceil(minRepetitionMs / std::max(warmupMs, 1e-6)));
+
+    std::vector<double> nsPerOp;
+    for (std::size_t r = 0; r < repetitions; r++) {
+        reset();
+        start = std::chrono::steady_clock::now();
+        for (std::size_t c = 0; c < calls; c++) checksum += f();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        nsPerOp.push_back(ns / static_cast<double>(calls * std::max<std::size_t>(ops, 1)));
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    results.push_back(BenchmarkResult{kernel, distribution, n, repetitions, calls,
+                                      nsPerOp[nsPerOp.size() / 2], nsPerOp.front(), nsPerOp.back(), checksum});
+    std::cerr << kernel << " " << distribution << " n=" << n << ": " << nsPerOp[nsPerOp.size() / 2]
+              << " ns/op\n";
+}
+
+void Benchmark::printTable(std::ostream &out) const {
+    out << std::left << std::setw(28) << "kernel" << std::setw(10) << "dist" << std::right << std::setw(8) << "n"
+        << std::setw(14) << "median ns/op" << std::setw(12) << "min ns/op" << std::setw(12) << "max ns/op" << "\n";
+    out << std::fixed << std::setprecision(2);
+    for (const BenchmarkResult &r: results) {
+        out << std::left << std::setw(28) << r.kernel << std::setw(10) << r.distribution << std::right
+            << std::setw(8) << r.n << std::setw(14) << r.medianNsPerOp << std::setw(12) << r.minNsPerOp
+            << std::setw(12) << r.maxNsPerOp << "\n";
+    }
+}
+
+bool Benchmark::writeCsv(const std::string &filename) const {
+    std::ofstream out(filename, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Couldn't open " << filename << " for writing.\n";
+        return false;
+    }
+    out << "kernel,distribution,n,repetitions,calls,median_ns_per_op,min_ns_per_op,max_ns_per_op,checksum\n";
+    out << std::setprecision(6);
+    for (const BenchmarkResult &r: results) {
+        out << r.kernel << "," << r.distribution << "," << r.n << "," << r.repetitions << "," << r.calls << ","
+            << r.medianNsPerOp << "," << r.minNsPerOp << "," << r.maxNsPerOp << "," << r.checksum << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool Benchmark::writeJson(const std::string &filename) const {
+    std::ofstream out(filename, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Couldn't open " << filename << " for writing.\n";
+        return false;
+    }
+    out << std::setprecision(6);
+    out << "{\"hardware_concurrency\":" << std::thread::hardware_concurrency() << ",\"results\":[";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        // a NaN checksum is no valid JSON number
+        double checksum = std::isfinite(r.checksum) ? r.checksum : 0.0;
+        out << (i == 0 ? "" : ",") << "\n{\"kernel\":\"" << r.kernel << "\",\"distribution\":\"" << r.distribution
+            << "\",\"n\":" << r.n << ",\"repetitions\":" << r.repetitions << ",\"calls\":" << r.calls
+            << ",\"median_ns_per_op\":" << r.medianNsPerOp << ",\"min_ns_per_op\":" << r.minNsPerOp
+            << ",\"max_ns_per_op\":" << r.maxNsPerOp << ",\"checksum\":" << checksum << "}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,71 @@
+//
+// Created by Trebing, Peter on 2019-09-21.
+//
+
+#ifndef COLLISIONSIM_BENCHMARK_H
+#define COLLISIONSIM_BENCHMARK_H
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Timing of one kernel for one workload
+ */
+struct BenchmarkResult {
+    std::string kernel;
+    std::string distribution;
+    std::size_t n;
+    std::size_t repetitions;
+    std::size_t calls;          // calls of the kernel per repetition
+    double medianNsPerOp;
+    double minNsPerOp;
+    double maxNsPerOp;
+    double checksum;            // result of the kernel, keeps the compiler from removing the work
+};
+
+/**
+ * Runs kernels repeatedly and collects their time per operation. Every kernel gets a
+ * warm up call, which also calibrates how often the kernel is called per repetition,
+ * so even short kernels are timed over at least minRepetitionMs.
+ */
+class Benchmark {
+
+public:
+
+    Benchmark(std::size_t repetitions, double minRepetitionMs, const std::string &filter) :
+            repetitions(repetitions), minRepetitionMs(minRepetitionMs), filter(filter) {}
+
+    /**
+     * Times a kernel, unless it is excluded by the filter
+     * @param kernel name of the kernel
+     * @param distribution name of the particle size distribution of the workload
+     * @param n number of particles of the workload
+     * @param ops number of operations of one call, e.g. the number of particles
+     * @param reset restores the input of the kernel before every repetition, it is not timed
+     * @param f the kernel, returns a checksum of its result
+     */
+    void run(const std::string &kernel, const std::string &distribution, std::size_t n, std::size_t ops,
+             const std::function<void()> &reset, const std::function<double()> &f);
+
+    void run(const std::string &kernel, const std::string &distribution, std::size_t n, std::size_t ops,
+             const std::function<double()> &f) { run(kernel, distribution, n, ops, []() {}, f); }
+
+    const std::vector<BenchmarkResult> &getResults() const { return results; }
+
+    void printTable(std::ostream &out) const;
+
+    bool writeCsv(const std::string &filename) const;
+
+    bool writeJson(const std::string &filename) const;
+
+private:
+    std::size_t repetitions;
+    double minRepetitionMs;
+    std::string filter;
+    std::vector<BenchmarkResult> results;
+};
+
+#endif //COLLISIONSIM_BENCHMARK_H
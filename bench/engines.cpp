@@ -0,0 +1,179 @@
+//
+// Created by Trebing, Peter on 2019-09-29.
+//
+// A/B comparison of the physics engines on the same scenario: every engine steps the same
+// seeded molecules for a number of simulated seconds at a fixed step, without damping, in
+// the calling thread. Reported are the physics (collision rate, temperature, pressure and
+// the drift of the total energy) next to the cost per simulated second:
+//
+//   collisionsim_engines --engine=time_step:bruteforce,time_step:grid,event_driven,dsmc --n=1000
+//
+// The broad phase of the time_step engine is given after a colon.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "workload.h"
+#include "configuration.h"
+#include "lockProfiler.h"
+#include "physicsEngine.h"
+#include "profiler.h"
+
+std::string Configuration::DEFAULT_CONFIGFILE = COLLISIONSIM_CONFIG;
+
+namespace {
+
+std::vector<std::string> split(const std::string &list, char delimiter) {
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, delimiter)) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+/**
+ * Kinetic plus potential energy of all molecules, the potential is zero at y = 0
+ */
+double totalEnergy(SimulationObjects &objects, const Vector3 &gravity) {
+    double energy = 0.0;
+    objects.map([&energy, &gravity](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        Particle &part = obj->getParticle();
+        double mass = part.getMass();
+        energy += 0.5 * mass * part.getVelocity().squareMagnitude() - mass * gravity.scalarProduct(part.getPosition());
+        return false;
+    });
+    return energy;
+}
+
+struct Result {
+    double collisionsPerSecond;     // per simulated second
+    double temperature;             // at the end
+    double pressure;                // over the whole run
+    double drift;                   // relative change of the total energy at the end
+    double msPerSecond;             // per simulated second
+};
+
+Result runEngine(Configuration config, const std::string &distribution, std::size_t n, double dt, double seconds,
+                 unsigned seed) {
+
+    std::unique_ptr<Workload> workload = createWorkload(distribution, n, 1.0, config.getGravityFactor(), seed);
+    config.setWindowWidth(workload->width);
+    config.setWindowHeight(workload->height);
+    SimulationObjects objects;
+    std::unique_ptr<PhysicsEngine> physics = createPhysicsEngine(config.getPhysicsEngine(), config, objects);
+    physics->addObjects(std::move(workload->objects));
+
+    Vector3 gravity = Vector3(Vector3::GRAVITY) * -config.getGravityFactor();
+    double initial = totalEnergy(objects, gravity);
+    Observables start = physics->getObservables();
+    std::size_t steps = static_cast<std::size_t>(std::llround(seconds / dt));
+    std::size_t collisions = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t s = 0; s < steps; s++) {
+        physics->step(dt);
+        collisions += physics->getCollisionsSincelastCall();
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    Observables end = physics->getObservables();
+    double perimeter = 2.0 * static_cast<double>(config.getWindowWidth() + config.getWindowHeight());
+    Result result;
+    result.collisionsPerSecond = static_cast<double>(collisions) / seconds;
+    result.temperature = end.temperature();
+    result.pressure = end.pressure(start, perimeter);
+    result.drift = std::abs(totalEnergy(objects, gravity) - initial) / std::abs(initial);
+    result.msPerSecond = elapsed / seconds;
+    return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+
+    std::vector<std::string> engines{"time_step:bruteforce", "time_step:grid", "event_driven", "dsmc"};
+    std::string distribution = "air";
+    std::size_t n = 1000;
+    double dt = 1.0;
+    double seconds = 2.0;
+    unsigned seed = 42;
+    std::string csvFile;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg(argv[a]);
+        auto delimiterPos = arg.find('=');
+        std::string key = arg.substr(0, delimiterPos);
+        std::string value = delimiterPos == std::string::npos ? "" : arg.substr(delimiterPos + 1);
+        if (key == "--engine") {
+            engines = split(value, ',');
+        } else if (key == "--dist") {
+            distribution = value;
+        } else if (key == "--n") {
+            n = std::stoul(value);
+        } else if (key == "--dt-ms") {
+            dt = std::stod(value);
+        } else if (key == "--seconds") {
+            seconds = std::stod(value);
+        } else if (key == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if (key == "--csv") {
+            csvFile = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--engine=time_step:bruteforce,time_step:grid,event_driven,dsmc]"
+                      << " [--dist=air] [--n=1000] [--dt-ms=1] [--seconds=2] [--seed=42] [--csv=file]\n";
+            return 1;
+        }
+    }
+
+    // the same scenario for all engines: no drag, nothing sleeps, no pass runs out of budget
+    Configuration config;
+    Profiler::setEnabled(false);
+    LockProfiler::setEnabled(false);
+    config.setDamping(1.0);
+    config.setSleepEpsilon(0.0);
+    config.setCollisionBudgetUs(0);
+
+    std::ofstream csv;
+    if (!csvFile.empty()) {
+        csv.open(csvFile, std::ios::trunc);
+        if (!csv.is_open()) {
+            std::cerr << "Couldn't open " << csvFile << " for writing.\n";
+            return 1;
+        }
+        csv << "engine,particles,dt_ms,simulated_s,collisions_per_s,temperature,pressure,energy_drift"
+            << ",ms_per_simulated_s" << std::endl;
+    }
+
+    std::cout << "engine                collisions/s  temperature   pressure      energy_drift  ms/simulated_s"
+              << std::endl;
+    for (const std::string &engine: engines) {
+        std::vector<std::string> parts = split(engine, ':');
+        Configuration variant = config;
+        variant.setPhysicsEngine(parts.empty() ? engine : parts[0]);
+        if (parts.size() > 1) variant.setBroadphase(parts[1]);
+        SimulationObjects probe;
+        if (!createPhysicsEngine(variant.getPhysicsEngine(), variant, probe)) {
+            std::cerr << "Unknown physics engine " << variant.getPhysicsEngine() << ".\n";
+            return 1;
+        }
+
+        Result result = runEngine(variant, distribution, n, dt / 1000.0, seconds, seed);
+        std::ostringstream line;
+        line.precision(4);
+        line << engine << std::string(22 - std::min<std::size_t>(engine.size(), 21), ' ')
+             << result.collisionsPerSecond << "\t" << result.temperature << "\t" << result.pressure << "\t"
+             << result.drift << "\t" << result.msPerSecond;
+        std::cout << line.str() << std::endl;
+        if (csv.is_open()) {
+            csv << engine << "," << n << "," << dt << "," << seconds << "," << result.collisionsPerSecond << ","
+                << result.temperature << "," << result.pressure << "," << result.drift << ","
+                << result.msPerSecond << std::endl;
+        }
+    }
+    return 0;
+}
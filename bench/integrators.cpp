@@ -0,0 +1,185 @@
+//
+// Created by Trebing, Peter on 2019-09-27.
+//
+// Compares the integrators: every integrator moves the same seeded molecules under gravity
+// and without damping or collisions for a number of simulated seconds, at several fixed
+// time steps. The total energy (kinetic plus potential) of such a system is constant, so
+// its drift is the error of the integrator, which is set against its cost. With a
+// Lennard-Jones depth the molecules interact by forces which depend on their positions:
+//
+//   collisionsim_integrators --integrator=euler,verlet --dt-ms=0.5,1,2,4,8 --seconds=10 --lj-epsilon=0,1e8
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "workload.h"
+#include "configuration.h"
+#include "lockProfiler.h"
+#include "particlePhysics2D.h"
+#include "profiler.h"
+
+std::string Configuration::DEFAULT_CONFIGFILE = COLLISIONSIM_CONFIG;
+
+namespace {
+
+std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+/**
+ * Kinetic plus potential energy of all molecules, the potential is zero at y = 0. The
+ * potential of the short range forces is computed at the current positions.
+ */
+double totalEnergy(SimulationObjects &objects, LennardJones *interactions) {
+    double energy = 0.0;
+    if (interactions != nullptr) {
+        interactions->compute(objects, 1);
+        energy += interactions->getPotentialEnergy();
+    }
+    objects.map([&energy](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        Particle &part = obj->getParticle();
+        double mass = part.getMass();
+        energy += 0.5 * mass * part.getVelocity().squareMagnitude() -
+                  mass * part.getAcceleration().scalarProduct(part.getPosition());
+        return false;
+    });
+    return energy;
+}
+
+struct Result {
+    double drift;           // relative change of the energy at the end
+    double maxDrift;        // largest relative change during the run
+    double nsPerStep;       // per molecule and step
+    double msPerSecond;     // per simulated second
+};
+
+Result runIntegrator(Configuration config, const std::string &distribution, std::size_t n, double dt,
+                     double seconds, unsigned seed) {
+
+    std::unique_ptr<Workload> workload = createWorkload(distribution, n, 1.0, config.getGravityFactor(), seed);
+    config.setWindowWidth(workload->width);
+    config.setWindowHeight(workload->height);
+    config.setSleepEpsilon(0.0);
+    SimulationObjects objects;
+    objects.append(std::move(workload->objects));
+    PatrticlePhysics2D physics(config, objects);
+
+    double initial = totalEnergy(objects, physics.getInteractions());
+    std::size_t steps = static_cast<std::size_t>(std::llround(seconds / dt));
+    // sample the energy about a hundred times, the samples are not timed
+    std::size_t sampleEvery = std::max<std::size_t>(steps / 100, 1);
+    Result result{0.0, 0.0, 0.0, 0.0};
+    std::chrono::nanoseconds elapsed(0);
+    for (std::size_t step = 0; step < steps; step += sampleEvery) {
+        std::size_t block = std::min(sampleEvery, steps - step);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t s = 0; s < block; s++) physics.integrate(dt);
+        elapsed += std::chrono::steady_clock::now() - start;
+        double drift = std::abs(totalEnergy(objects, physics.getInteractions()) - initial) / std::abs(initial);
+        result.maxDrift = std::max(result.maxDrift, drift);
+        result.drift = drift;
+    }
+    double total = static_cast<double>(elapsed.count());
+    result.nsPerStep = total / static_cast<double>(std::max<std::size_t>(steps * n, 1));
+    result.msPerSecond = total / 1e6 / seconds;
+    return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+
+    std::vector<std::string> integrators{"euler", "verlet"};
+    std::vector<double> timesteps{0.5, 1.0, 2.0, 4.0, 8.0};
+    std::vector<double> depths{0.0};
+    std::string distribution = "air";
+    std::size_t n = 1000;
+    double seconds = 10.0;
+    unsigned seed = 42;
+    std::string csvFile;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg(argv[a]);
+        auto delimiterPos = arg.find('=');
+        std::string key = arg.substr(0, delimiterPos);
+        std::string value = delimiterPos == std::string::npos ? "" : arg.substr(delimiterPos + 1);
+        if (key == "--integrator") {
+            integrators = split(value);
+        } else if (key == "--dt-ms") {
+            timesteps.clear();
+            for (auto &dt: split(value)) timesteps.push_back(std::stod(dt));
+        } else if (key == "--lj-epsilon") {
+            depths.clear();
+            for (auto &depth: split(value)) depths.push_back(std::stod(depth));
+        } else if (key == "--dist") {
+            distribution = value;
+        } else if (key == "--n") {
+            n = std::stoul(value);
+        } else if (key == "--seconds") {
+            seconds = std::stod(value);
+        } else if (key == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if (key == "--csv") {
+            csvFile = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--integrator=euler,verlet] [--dt-ms=0.5,1,2,4,8]"
+                      << " [--lj-epsilon=0]"
+                      << " [--dist=air] [--n=1000] [--seconds=10] [--seed=42] [--csv=file]\n";
+            return 1;
+        }
+    }
+
+    Configuration config;
+    Profiler::setEnabled(false);
+    LockProfiler::setEnabled(false);
+    config.setTimestepMultirate(false);
+
+    std::ofstream csv;
+    if (!csvFile.empty()) {
+        csv.open(csvFile, std::ios::trunc);
+        if (!csv.is_open()) {
+            std::cerr << "Couldn't open " << csvFile << " for writing.\n";
+            return 1;
+        }
+        csv << "integrator,lj_epsilon,dt_ms,particles,simulated_s,energy_drift,max_energy_drift,ns_per_particle_step"
+            << ",ms_per_simulated_s" << std::endl;
+    }
+
+    std::cout << "integrator  lj_epsilon  dt_ms   energy_drift  max_drift     ns/particle/step  ms/simulated_s"
+              << std::endl;
+    for (const std::string &integrator: integrators) {
+        if (integrator != "euler" && integrator != "verlet") {
+            std::cerr << "Unknown integrator " << integrator << ".\n";
+            return 1;
+        }
+        config.setIntegrator(integrator);
+        for (double depth: depths) {
+            config.setLjEpsilon(depth);
+            for (double dt: timesteps) {
+                Result result = runIntegrator(config, distribution, n, dt / 1000.0, seconds, seed);
+                std::ostringstream line;
+                line.precision(4);
+                line << integrator << std::string(12 - std::min<std::size_t>(integrator.size(), 11), ' ') << depth
+                     << "\t    " << dt << "\t" << result.drift << "\t" << result.maxDrift << "\t"
+                     << result.nsPerStep << "\t\t" << result.msPerSecond;
+                std::cout << line.str() << std::endl;
+                if (csv.is_open()) {
+                    csv << integrator << "," << depth << "," << dt << "," << n << "," << seconds << ","
+                        << result.drift << "," << result.maxDrift << "," << result.nsPerStep << ","
+                        << result.msPerSecond << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
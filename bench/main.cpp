@@ -0,0 +1,278 @@
+//
+// Created by Trebing, Peter on 2019-09-21.
+//
+// Microbenchmarks of the simulation kernels. Every kernel is timed for each combination
+// of particle count and size distribution, the results are printed as a table and
+// optionally written as CSV and JSON:
+//
+//   collisionsim_bench --n=100,1000,4000 --dist=air,wide --reps=7 --csv=bench.csv --json=bench.json
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include "benchmark.h"
+#include "workload.h"
+#include "broadphase.h"
+#include "configuration.h"
+#include "lockProfiler.h"
+#include "particlePhysics2D.h"
+#include "profiler.h"
+
+std::string Configuration::DEFAULT_CONFIGFILE = COLLISIONSIM_CONFIG;
+
+namespace {
+
+// Brute force checks n^2 pairs, larger workloads would take minutes
+const std::size_t BRUTE_FORCE_MAX_N = 20000;
+
+// Neighbours in x order each box is tested against in the intersection kernel
+const std::size_t INTERSECTION_NEIGHBOURS = 4;
+
+const double TIME_STEP = 0.001;
+
+std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+void benchmarkVector3(Benchmark &bench, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    const std::string &dist = workload.distribution;
+    std::vector<Vector3> positions, velocities;
+    for (auto &obj: workload.objects) {
+        positions.push_back(obj->getParticle().getPosition());
+        velocities.push_back(obj->getParticle().getVelocity());
+    }
+    std::vector<Vector3> p;
+
+    bench.run("vector3_add_scaled", dist, n, n, [&]() { p = positions; }, [&]() {
+        for (std::size_t i = 0; i < n; i++) p[i].addScaledVector(velocities[i], TIME_STEP);
+        return p[n - 1].x;
+    });
+
+    bench.run("vector3_arithmetic", dist, n, n, [&]() {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < n; i++) {
+            Vector3 v = (positions[i] - velocities[i]) * 0.5 + velocities[i];
+            sum += v.x + v.y;
+        }
+        return sum;
+    });
+
+    bench.run("vector3_scalar_product", dist, n, n, [&]() {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < n; i++) sum += positions[i].scalarProduct(velocities[i]);
+        return sum;
+    });
+
+    bench.run("vector3_magnitude", dist, n, n, [&]() {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < n; i++) sum += velocities[i].magnitude();
+        return sum;
+    });
+}
+
+void benchmarkIntegrate(Benchmark &bench, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    std::vector<Particle> initial, particles;
+    for (auto &obj: workload.objects) initial.push_back(obj->getParticle());
+
+    bench.run("particle_integrate", workload.distribution, n, n, [&]() { particles = initial; }, [&]() {
+        for (Particle &part: particles) part.integrate(TIME_STEP);
+        return particles[n - 1].getPosition().x;
+    });
+}
+
+void benchmarkIntersection(Benchmark &bench, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    std::vector<Box> boxes = workload.boxes();
+    // neighbours in x order overlap in x, so both outcomes of the test occur
+    std::sort(boxes.begin(), boxes.end(), [](const Box &a, const Box &b) { return a.l.x < b.l.x; });
+    std::size_t tests = n > INTERSECTION_NEIGHBOURS ? (n - INTERSECTION_NEIGHBOURS) * INTERSECTION_NEIGHBOURS : 0;
+    if (tests == 0) return;
+
+    bench.run("has_intersection", workload.distribution, n, tests, [&]() {
+        std::size_t hits = 0;
+        for (std::size_t i = 0; i + INTERSECTION_NEIGHBOURS < n; i++) {
+            for (std::size_t k = 1; k <= INTERSECTION_NEIGHBOURS; k++) {
+                if (hasIntersection(boxes[i], boxes[i + k])) ++hits;
+            }
+        }
+        return static_cast<double>(hits);
+    });
+}
+
+void benchmarkBroadphases(Benchmark &bench, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    std::vector<Box> boxes = workload.boxes();
+    std::vector<Pair> pairs;
+
+    for (const std::string &name: broadphaseNames()) {
+        if (name == "bruteforce" && n > BRUTE_FORCE_MAX_N) continue;
+        std::unique_ptr<Broadphase> broadphase = createBroadphase(name);
+        bench.run(std::string("broadphase_") + broadphase->getName(), workload.distribution, n, n, [&]() {
+            broadphase->findAllPairs(boxes, pairs);
+            return static_cast<double>(pairs.size());
+        });
+    }
+}
+
+void benchmarkResolve(Benchmark &bench, Configuration &config, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    if (n > BRUTE_FORCE_MAX_N) return;
+
+    // resolve every overlapping pair once
+    std::vector<Box> boxes = workload.boxes();
+    std::vector<Pair> found, pairs;
+    BruteForceBroadphase().findAllPairs(boxes, found);
+    for (const Pair &pair: found) {
+        if (pair.i < pair.j) pairs.push_back(pair);
+    }
+    if (pairs.empty()) return;
+
+    std::vector<std::shared_ptr<SimulationObject>> objects = workload.objects;
+    std::vector<Particle> initial;
+    for (auto &obj: objects) initial.push_back(obj->getParticle());
+
+    SimulationObjects list;
+    PatrticlePhysics2D physics(config, list);
+
+    bench.run("resolve_collisions", workload.distribution, n, pairs.size(), [&]() {
+        for (std::size_t i = 0; i < n; i++) objects[i]->getParticle() = initial[i];
+    }, [&]() {
+        for (const Pair &pair: pairs) physics.resolveCollisions(objects[pair.i], objects[pair.j]);
+        return objects[pairs.front().i]->getParticle().getVelocity().x;
+    });
+
+    // the objects are shared with the other kernels
+    for (std::size_t i = 0; i < n; i++) objects[i]->getParticle() = initial[i];
+}
+
+void benchmarkMap(Benchmark &bench, const Workload &workload) {
+
+    std::size_t n = workload.objects.size();
+    SimulationObjects list;
+    std::vector<std::shared_ptr<SimulationObject>> items = workload.objects;
+    list.append(std::move(items));
+    auto sumX = [](double &sum) {
+        return [&sum](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+            sum += obj->getParticle().getPosition().x;
+            return false;
+        };
+    };
+
+    // baseline without the lock and the std::function call
+    bench.run("vector_loop", workload.distribution, n, n, [&]() {
+        double sum = 0.0;
+        for (auto &obj: workload.objects) sum += obj->getParticle().getPosition().x;
+        return sum;
+    });
+
+    LockProfiler::setEnabled(false);
+    bench.run("list_map", workload.distribution, n, n, [&]() {
+        double sum = 0.0;
+        list.map(sumX(sum));
+        return sum;
+    });
+
+    LockProfiler::setEnabled(true);
+    bench.run("list_map_lock_profiled", workload.distribution, n, n, [&]() {
+        double sum = 0.0;
+        list.map(sumX(sum));
+        return sum;
+    });
+    LockProfiler::setEnabled(false);
+
+    // removes every tenth item by its handle and adds it back
+    std::vector<SlotHandle> handles(n);
+    for (std::size_t i = 0; i < n; i++) handles[i] = list.handle(i);
+    std::size_t churn = (n + 9) / 10;
+    bench.run("list_churn", workload.distribution, n, churn, [&]() {
+        for (std::size_t k = 0; k < churn; k++) {
+            SlotHandle &handle = handles[k * 10];
+            std::shared_ptr<SimulationObject> obj = list.get(handle);
+            list.erase(handle);
+            handle = list.pushBack(std::move(obj));
+        }
+        return static_cast<double>(list.size());
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+
+    std::vector<std::size_t> counts{100, 1000, 4000};
+    std::vector<std::string> distributions = workloadDistributions();
+    std::size_t repetitions = 7;
+    double minRepetitionMs = 20.0;
+    unsigned seed = 42;
+    std::string filter, csvFile, jsonFile;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg(argv[a]);
+        auto delimiterPos = arg.find('=');
+        std::string key = arg.substr(0, delimiterPos);
+        std::string value = delimiterPos == std::string::npos ? "" : arg.substr(delimiterPos + 1);
+        if (key == "--n") {
+            counts.clear();
+            for (auto &count: split(value)) counts.push_back(std::stoul(count));
+        } else if (key == "--dist") {
+            distributions = split(value);
+        } else if (key == "--reps") {
+            repetitions = std::max<std::size_t>(std::stoul(value), 1);
+        } else if (key == "--min-ms") {
+            minRepetitionMs = std::stod(value);
+        } else if (key == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if (key == "--filter") {
+            filter = value;
+        } else if (key == "--csv") {
+            csvFile = value;
+        } else if (key == "--json") {
+            jsonFile = value;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--n=100,1000] [--dist=air,uniform,wide] [--reps=7]"
+                      << " [--min-ms=20] [--seed=42] [--filter=kernel] [--csv=file] [--json=file]\n";
+            return 1;
+        }
+    }
+
+    // the kernels are timed without instrumentation
+    Configuration config;
+    Profiler::setEnabled(false);
+    LockProfiler::setEnabled(false);
+
+    Benchmark bench(repetitions, minRepetitionMs, filter);
+    for (const std::string &distribution: distributions) {
+        for (std::size_t n: counts) {
+            if (n == 0) continue;
+            std::unique_ptr<Workload> workload = createWorkload(distribution, n, config.getDamping(),
+                                                                config.getGravityFactor(), seed);
+            if (!workload) return 1;
+            benchmarkVector3(bench, *workload);
+            benchmarkIntegrate(bench, *workload);
+            benchmarkIntersection(bench, *workload);
+            benchmarkBroadphases(bench, *workload);
+            benchmarkResolve(bench, config, *workload);
+            benchmarkMap(bench, *workload);
+        }
+    }
+
+    bench.printTable(std::cout);
+    if (!csvFile.empty() && !bench.writeCsv(csvFile)) return 1;
+    if (!jsonFile.empty() && !bench.writeJson(jsonFile)) return 1;
+    return 0;
+}
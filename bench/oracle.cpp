@@ -0,0 +1,248 @@
+//
+// Created by Trebing, Peter on 2019-09-23.
+//
+// Differential oracle for the collision detection. Two physics instances start from the
+// same seeded state, one with the brute force broad phase as reference and one with the
+// broad phase under test. After every step the candidate pairs and the positions and
+// velocities of all molecules must be identical, and neither may resolve a pair twice:
+//
+//   collisionsim_oracle --broadphase=grid --n=100,1000,5000 --dist=air,wide --steps=200
+//
+// The exit code is 0 if all runs agree, 1 otherwise.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include "workload.h"
+#include "broadphase.h"
+#include "configuration.h"
+#include "lockProfiler.h"
+#include "particlePhysics2D.h"
+#include "profiler.h"
+
+std::string Configuration::DEFAULT_CONFIGFILE = COLLISIONSIM_CONFIG;
+
+namespace {
+
+std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+std::string describe(const std::vector<Pair> &pairs, std::size_t max) {
+    std::ostringstream out;
+    for (std::size_t k = 0; k < pairs.size() && k < max; k++) {
+        out << (k == 0 ? "" : " ") << "(" << pairs[k].i << "," << pairs[k].j << ")";
+    }
+    if (pairs.size() > max) out << " ...";
+    return out.str();
+}
+
+bool pairLess(const Pair &a, const Pair &b) { return a.i != b.i ? a.i < b.i : a.j < b.j; }
+
+/**
+ * Compares the candidate pairs of both physics instances
+ * @return false and reports the difference, if they are not identical
+ */
+bool comparePairs(const std::vector<Pair> &reference, const std::vector<Pair> &candidate, std::size_t step) {
+    std::vector<Pair> expected(reference), found(candidate);
+    std::sort(expected.begin(), expected.end(), pairLess);
+    std::sort(found.begin(), found.end(), pairLess);
+    std::vector<Pair> missing, extra;
+    std::set_difference(expected.begin(), expected.end(), found.begin(), found.end(), std::back_inserter(missing),
+                        pairLess);
+    std::set_difference(found.begin(), found.end(), expected.begin(), expected.end(), std::back_inserter(extra),
+                        pairLess);
+    if (!missing.empty() || !extra.empty()) {
+        std::cerr << "  step " << step << ": pair sets differ, " << missing.size() << " missing: "
+                  << describe(missing, 8) << ", " << extra.size() << " extra: " << describe(extra, 8) << "\n";
+        return false;
+    }
+    // the order of resolution changes the outcome, so it has to be the same as well
+    for (std::size_t k = 0; k < reference.size(); k++) {
+        if (reference[k].i != candidate[k].i || reference[k].j != candidate[k].j) {
+            std::cerr << "  step " << step << ": pairs are resolved in a different order, first at " << k << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks that no pair was resolved twice in a pass: a pair found from both sides must be
+ * resolved once
+ * @return false and reports the first repeated pair
+ */
+bool checkResolvedOnce(const std::vector<Pair> &resolved, std::size_t step, const char *name) {
+    std::vector<Pair> pairs;
+    for (const Pair &pair: resolved) pairs.push_back(pair.i < pair.j ? pair : Pair{pair.j, pair.i});
+    std::sort(pairs.begin(), pairs.end(), pairLess);
+    auto repeated = std::adjacent_find(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b) {
+        return a.i == b.i && a.j == b.j;
+    });
+    if (repeated != pairs.end()) {
+        std::cerr << "  step " << step << ": " << name << " resolved the pair (" << repeated->i << ","
+                  << repeated->j << ") more than once\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Compares positions and velocities of both sets of molecules
+ * @return the largest deviation, or infinity if the number of molecules differs
+ */
+double compareStates(SimulationObjects &reference, SimulationObjects &candidate, std::size_t step,
+                     double tolerance, bool &identical) {
+    std::vector<Vector3> state;
+    reference.map([&state](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        state.push_back(obj->getParticle().getPosition());
+        state.push_back(obj->getParticle().getVelocity());
+        return false;
+    });
+    double deviation = 0.0;
+    std::size_t first = std::numeric_limits<std::size_t>::max();
+    std::size_t count = 0;
+    candidate.map([&](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        if (2 * i + 1 >= state.size()) return true;
+        const Vector3 position = obj->getParticle().getPosition();
+        const Vector3 velocity = obj->getParticle().getVelocity();
+        double d = std::max({std::abs(position.x - state[2 * i].x), std::abs(position.y - state[2 * i].y),
+                             std::abs(velocity.x - state[2 * i + 1].x), std::abs(velocity.y - state[2 * i + 1].y)});
+        if (d > tolerance && first == std::numeric_limits<std::size_t>::max()) first = i;
+        deviation = std::max(deviation, d);
+        ++count;
+        return false;
+    });
+    if (2 * count != state.size()) {
+        std::cerr << "  step " << step << ": " << count << " molecules instead of " << state.size() / 2 << "\n";
+        identical = false;
+        return std::numeric_limits<double>::infinity();
+    }
+    if (first != std::numeric_limits<std::size_t>::max()) {
+        std::cerr << "  step " << step << ": molecule " << first << " deviates, largest deviation " << deviation
+                  << "\n";
+        identical = false;
+    }
+    return deviation;
+}
+
+/**
+ * Runs reference and candidate side by side
+ * @return true, if they agree in every step
+ */
+bool runDifferential(Configuration config, const std::string &broadphase, const std::string &distribution,
+                     std::size_t n, std::size_t steps, unsigned seed, double tolerance) {
+
+    // the same seed creates the same molecules twice
+    std::unique_ptr<Workload> referenceWorkload = createWorkload(distribution, n, config.getDamping(),
+                                                                 config.getGravityFactor(), seed);
+    std::unique_ptr<Workload> candidateWorkload = createWorkload(distribution, n, config.getDamping(),
+                                                                 config.getGravityFactor(), seed);
+    if (!referenceWorkload || !candidateWorkload) return false;
+
+    config.setWindowWidth(referenceWorkload->width);
+    config.setWindowHeight(referenceWorkload->height);
+    // a truncated pass depends on the speed of the broad phase, which differs by design
+    config.setCollisionLimit(std::numeric_limits<std::size_t>::max());
+    config.setCollisionBudgetUs(0);
+
+    SimulationObjects referenceObjects, candidateObjects;
+    referenceObjects.append(std::move(referenceWorkload->objects));
+    candidateObjects.append(std::move(candidateWorkload->objects));
+
+    config.setBroadphase(broadphaseNames().front());
+    PatrticlePhysics2D reference(config, referenceObjects);
+    config.setBroadphase(broadphase);
+    PatrticlePhysics2D candidate(config, candidateObjects);
+
+    double duration = static_cast<double>(std::max<std::size_t>(config.getPhysicIntervalMs(), 1)) / 1000.0;
+    std::size_t pairs = 0, collisions = 0;
+    double deviation = 0.0;
+    bool identical = true;
+    for (std::size_t step = 0; step < steps && identical; step++) {
+        reference.integrate(duration);
+        candidate.integrate(duration);
+        std::size_t resolved = reference.detectCollisions();
+        if (candidate.detectCollisions() != resolved) {
+            std::cerr << "  step " << step << ": different number of resolved collisions\n";
+            identical = false;
+        }
+        identical = comparePairs(reference.getPairs(), candidate.getPairs(), step) && identical;
+        identical = checkResolvedOnce(reference.getResolvedPairs(), step, "reference") && identical;
+        identical = checkResolvedOnce(candidate.getResolvedPairs(), step, "candidate") && identical;
+        deviation = std::max(deviation, compareStates(referenceObjects, candidateObjects, step, tolerance,
+                                                      identical));
+        pairs += reference.getPairs().size();
+        collisions += resolved;
+    }
+
+    std::cout << (identical ? "PASS " : "FAIL ") << broadphase << " " << distribution << " n=" << n << ": "
+              << steps << " steps, " << pairs << " pairs, " << collisions << " collisions, max deviation "
+              << deviation << std::endl;
+    return identical;
+}
+
+}
+
+int main(int argc, char **argv) {
+
+    std::vector<std::size_t> counts{100, 1000, 3000};
+    std::vector<std::string> distributions = workloadDistributions();
+    std::vector<std::string> broadphases(broadphaseNames().begin() + 1, broadphaseNames().end());
+    std::size_t steps = 200;
+    unsigned seed = 42;
+    double tolerance = 0.0;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg(argv[a]);
+        auto delimiterPos = arg.find('=');
+        std::string key = arg.substr(0, delimiterPos);
+        std::string value = delimiterPos == std::string::npos ? "" : arg.substr(delimiterPos + 1);
+        if (key == "--n") {
+            counts.clear();
+            for (auto &count: split(value)) counts.push_back(std::stoul(count));
+        } else if (key == "--dist") {
+            distributions = split(value);
+        } else if (key == "--broadphase") {
+            broadphases = split(value);
+        } else if (key == "--steps") {
+            steps = std::stoul(value);
+        } else if (key == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if (key == "--tolerance") {
+            tolerance = std::stod(value);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--broadphase=grid] [--n=100,1000] [--dist=air,uniform,wide]"
+                      << " [--steps=200] [--seed=42] [--tolerance=0]\n";
+            return 1;
+        }
+    }
+
+    Configuration config;
+    Profiler::setEnabled(false);
+    LockProfiler::setEnabled(false);
+
+    bool passed = true;
+    for (const std::string &broadphase: broadphases) {
+        if (!createBroadphase(broadphase)) {
+            std::cerr << "Unknown broadphase " << broadphase << ".\n";
+            return 1;
+        }
+        for (const std::string &distribution: distributions) {
+            for (std::size_t n: counts) {
+                passed = runDifferential(config, broadphase, distribution, n, steps, seed, tolerance) && passed;
+            }
+        }
+    }
+    return passed ? 0 : 1;
+}
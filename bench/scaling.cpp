@@ -0,0 +1,265 @@
+//
+// Created by Trebing, Peter on 2019-09-22.
+//
+// Headless scaling driver. Runs the physics and collision threads of the simulation,
+// without rendering, for every combination of the given configuration values and
+// records the throughput, the peak memory and the time of each phase as CSV:
+//
+//   collisionsim_scale --duration=10 particle_count=100,1000,10000 worker_threads=1,4
+//
+// Every argument key=v1,v2,... overrides a key of simulation_config.txt and adds an axis
+// to the matrix. Each combination runs in a process of its own, so the peak memory of
+// one run does not carry over to the next.
+//
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "configuration.h"
+#include "lockProfiler.h"
+#include "perfCounters.h"
+#include "physicsEngine.h"
+#include "placement.h"
+#include "profiler.h"
+
+std::string Configuration::DEFAULT_CONFIGFILE = COLLISIONSIM_CONFIG;
+
+namespace {
+
+// phases read with the hardware counters, if perf_counters=1
+const Phase COUNTED_PHASES[] = {phaseIntegrate, phaseBroadphase, phaseNarrowphase};
+
+struct Axis {
+    std::string key;
+    std::vector<std::string> values;
+};
+
+std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+std::string header(const std::vector<Axis> &axes) {
+    std::ostringstream out;
+    for (const Axis &axis: axes) out << axis.key << ",";
+    out << "particles,place_ms,target_steps_per_s,steps_per_s,collision_passes_per_s,collisions_per_s,peak_rss_kb"
+        << ",temperature,pressure,collision_energy_change,asleep,timestep_ms,substeps,integrations_per_s";
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        if (p == phaseRender) continue;
+        const char *name = ProfileSnapshot::phaseName(static_cast<Phase>(p));
+        out << "," << name << "_mean_us," << name << "_p50_us," << name << "_p99_us";
+    }
+    for (Phase phase: COUNTED_PHASES) {
+        const char *name = ProfileSnapshot::phaseName(phase);
+        out << "," << name << "_ipc," << name << "_cache_misses_per_particle," << name
+            << "_branch_misses_per_particle";
+    }
+    return out.str();
+}
+
+/**
+ * Runs one combination and returns its CSV row
+ */
+std::string runCell(Configuration config, const std::vector<std::string> &values, double warmupS,
+                    double durationS, unsigned seed) {
+
+    Profiler::setEnabled(true);
+    LockProfiler::setEnabled(config.getLockProfiling());
+    PerfCounters::setEnabled(config.getPerfCounters());
+
+    SimulationObjects objects;
+    std::mt19937 engine(seed);
+    auto placeStart = std::chrono::steady_clock::now();
+    objects.append(placeParticles(config, static_cast<int>(config.getParticleCount()), engine));
+    double placeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - placeStart).count();
+
+    std::unique_ptr<PhysicsEngine> physics = createPhysicsEngine(config.getPhysicsEngine(), config, objects);
+    if (!physics) {
+        std::cerr << "Unknown physics engine " << config.getPhysicsEngine() << ", using time_step.\n";
+        physics = createPhysicsEngine("time_step", config, objects);
+    }
+    std::thread integrate([&]() { physics->run(); });
+    std::thread collider([&]() { physics->collider(); });
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(warmupS));
+    std::size_t steps = physics->getSteps();
+    physics->getCollisionsSincelastCall();
+    ProfileSnapshot profile = Profiler::snapshot();
+    CounterSnapshot counters = PerfCounters::snapshot();
+    Observables observables = physics->getObservables();
+    auto start = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(durationS));
+    steps = physics->getSteps() - steps;
+    std::size_t collisions = physics->getCollisionsSincelastCall();
+    profile = Profiler::snapshot() - profile;
+    counters = PerfCounters::snapshot() - counters;
+    Observables earlier = observables;
+    observables = physics->getObservables();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    physics->stop();
+    integrate.join();
+    collider.join();
+
+    std::ostringstream out;
+    out.precision(6);
+    for (const std::string &value: values) out << value << ",";
+    double interval = static_cast<double>(std::max<std::size_t>(config.getPhysicIntervalMs(), 1));
+    out << objects.size() << "," << placeMs << "," << 1000.0 / interval << "," << steps / elapsed << ","
+        << profile.count(phaseBroadphase) / elapsed << "," << collisions / elapsed << "," << peakRssKb();
+    double perimeter = 2.0 * static_cast<double>(config.getWindowWidth() + config.getWindowHeight());
+    out << "," << observables.temperature() << "," << observables.pressure(earlier, perimeter) << ","
+        << observables.collisionEnergyChange - earlier.collisionEnergyChange << "," << observables.asleep << ","
+        << observables.timestep * 1000.0 << "," << observables.substeps << ","
+        << (observables.integrations - earlier.integrations) / elapsed;
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        if (p == phaseRender) continue;
+        Phase phase = static_cast<Phase>(p);
+        uint64_t count = profile.count(phase);
+        out << "," << (count > 0 ? profile.total(phase) / 1000.0 / count : 0.0)
+            << "," << profile.percentile(phase, 0.5) / 1000.0 << "," << profile.percentile(phase, 0.99) / 1000.0;
+    }
+    for (Phase phase: COUNTED_PHASES) {
+        out << "," << counters.ipc(phase) << "," << counters.perParticle(phase, counterCacheMisses) << ","
+            << counters.perParticle(phase, counterBranchMisses);
+    }
+    return out.str();
+}
+
+/**
+ * Runs a combination in a child process and returns its CSV row, or an empty string on failure
+ */
+std::string runIsolated(const Configuration &config, const std::vector<std::string> &values, double warmupS,
+                        double durationS, unsigned seed) {
+    int fd[2];
+    if (pipe(fd) != 0) {
+        std::cerr << "Couldn't create a pipe.\n";
+        return "";
+    }
+    // the child would print the buffered output of the parent once more
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Couldn't fork.\n";
+        close(fd[0]);
+        close(fd[1]);
+        return "";
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        std::string row = runCell(config, values, warmupS, durationS, seed) + "\n";
+        bool written = write(fd[1], row.data(), row.size()) == static_cast<ssize_t>(row.size());
+        close(fd[1]);
+        std::cout.flush();
+        _exit(written ? 0 : 1);
+    }
+    close(fd[1]);
+    std::string row;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd[0], buffer, sizeof(buffer))) > 0) row.append(buffer, static_cast<std::size_t>(n));
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || row.empty()) return "";
+    row.pop_back();
+    return row;
+}
+
+}
+
+int main(int argc, char **argv) {
+
+    double durationS = 10.0;
+    double warmupS = 1.0;
+    unsigned seed = 42;
+    std::string csvFile = "scaling.csv";
+    std::vector<Axis> axes;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg(argv[a]);
+        auto delimiterPos = arg.find('=');
+        if (delimiterPos == std::string::npos || delimiterPos == 0) {
+            std::cerr << "Usage: " << argv[0] << " [--duration=10] [--warmup=1] [--seed=42] [--csv=scaling.csv]"
+                      << " [key=value1,value2,...]...\n";
+            return 1;
+        }
+        std::string key = arg.substr(0, delimiterPos);
+        std::string value = arg.substr(delimiterPos + 1);
+        if (key == "--duration") {
+            durationS = std::stod(value);
+        } else if (key == "--warmup") {
+            warmupS = std::stod(value);
+        } else if (key == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(value));
+        } else if (key == "--csv") {
+            csvFile = value;
+        } else {
+            axes.push_back(Axis{key, split(value)});
+            if (axes.back().values.empty()) {
+                std::cerr << "No values given for " << key << ".\n";
+                return 1;
+            }
+        }
+    }
+    if (axes.empty()) axes.push_back(Axis{"particle_count", {"100", "1000", "10000"}});
+
+    Configuration config;
+
+    std::ofstream csv(csvFile, std::ios::trunc);
+    if (!csv.is_open()) {
+        std::cerr << "Couldn't open " << csvFile << " for writing.\n";
+        return 1;
+    }
+    csv << header(axes) << std::endl;
+
+    // iterate over the cartesian product of all axes, the last axis changes fastest
+    std::vector<std::size_t> index(axes.size(), 0);
+    bool failed = false;
+    while (true) {
+        Configuration cell = config;
+        std::ostringstream overrides;
+        std::vector<std::string> values;
+        for (std::size_t a = 0; a < axes.size(); a++) {
+            values.push_back(axes[a].values[index[a]]);
+            overrides << axes[a].key << "=" << values.back() << "\n";
+        }
+        cell.merge(overrides.str());
+
+        std::string row = runIsolated(cell, values, warmupS, durationS, seed);
+        if (row.empty()) {
+            std::cerr << "Run failed: " << overrides.str();
+            failed = true;
+        } else {
+            csv << row << std::endl;
+            std::cout << "Scaling: " << row << std::endl;
+        }
+
+        std::size_t a = axes.size();
+        while (a > 0 && ++index[a - 1] == axes[a - 1].values.size()) index[--a] = 0;
+        if (a == 0) break;
+    }
+    return failed ? 1 : 0;
+}
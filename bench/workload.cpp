@@ -0,0 +1,75 @@
+//
+// Created by Trebing, Peter on 2019-09-21.
+//
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "molecules.h"
+#include "workload.h"
+
+namespace {
+
+// Share of the box covered by molecules
+const double FILL_FACTOR = 0.1;
+
+}
+
+std::vector<Box> Workload::boxes() const {
+    std::vector<Box> result;
+    result.reserve(objects.size());
+    for (auto &obj: objects) result.push_back(getBox(*obj));
+    return result;
+}
+
+const std::vector<std::string> &workloadDistributions() {
+    static const std::vector<std::string> names{"air", "uniform", "wide"};
+    return names;
+}
+
+std::unique_ptr<Workload> createWorkload(const std::string &distribution, std::size_t n,
+                                         double damping, double gravityFactor, unsigned seed) {
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+    std::uniform_int_distribution<int> wideSize(2, 32);
+
+    std::unique_ptr<Workload> workload(new Workload());
+    workload->distribution = distribution;
+    double area = 0.0;
+    for (std::size_t i = 0; i < n; i++) {
+        Molecule *molecule;
+        if (distribution == "air") {
+            double s = share(rng);
+            molecule = s < 0.78 ? static_cast<Molecule *>(new N2()) :
+                       s < 0.99 ? static_cast<Molecule *>(new O2()) : static_cast<Molecule *>(new CO2());
+        } else if (distribution == "uniform") {
+            molecule = new N2();
+        } else if (distribution == "wide") {
+            int size = wideSize(rng);
+            molecule = new Molecule(nitrogen, {0, 102, 153, 255}, size);
+            molecule->getParticle().setMass(size * size * 14.0067);
+        } else {
+            std::cerr << "Unknown size distribution " << distribution << ".\n";
+            return nullptr;
+        }
+        double size = static_cast<double>(molecule->getSize());
+        area += size * size;
+        workload->objects.emplace_back(molecule);
+    }
+
+    double side = std::ceil(std::sqrt(area / FILL_FACTOR)) + 32.0;
+    workload->width = workload->height = static_cast<std::size_t>(side);
+
+    std::uniform_real_distribution<double> velocity(-150.0, 150.0);
+    for (auto &obj: workload->objects) {
+        double size = static_cast<double>(obj->getSize());
+        std::uniform_real_distribution<double> position(0.0, side - size);
+        Particle &part = obj->getParticle();
+        part.setPosition(position(rng), position(rng), 0.0);
+        part.setVelocity(Vector3(velocity(rng), velocity(rng), 0.0));
+        part.setAcceleration(Vector3(Vector3::GRAVITY) * -gravityFactor);
+        part.setDamping(damping);
+    }
+    return workload;
+}
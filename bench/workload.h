@@ -0,0 +1,45 @@
+//
+// Created by Trebing, Peter on 2019-09-21.
+//
+
+#ifndef COLLISIONSIM_WORKLOAD_H
+#define COLLISIONSIM_WORKLOAD_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "simulationObject.h"
+#include "collision.h"
+
+/**
+ * A reproducible set of molecules for the benchmarks. The box grows with the number of
+ * molecules, so the density and the share of overlapping molecules stay the same.
+ */
+struct Workload {
+    std::string distribution;
+    std::size_t width;
+    std::size_t height;
+    std::vector<std::shared_ptr<SimulationObject>> objects;
+
+    /**
+     * Returns the bounding boxes of all objects at their current position
+     */
+    std::vector<Box> boxes() const;
+};
+
+/**
+ * Names of the supported size distributions:
+ *   air      78% N2, 21% O2 and 1% CO2 like the simulation
+ *   uniform  molecules of the same size
+ *   wide     sizes spread evenly from 2 to 32 pixels
+ */
+const std::vector<std::string> &workloadDistributions();
+
+/**
+ * Creates the molecules of a distribution at random positions and velocities
+ * @return nullptr, if the distribution is unknown
+ */
+std::unique_ptr<Workload> createWorkload(const std::string &distribution, std::size_t n,
+                                         double damping, double gravityFactor, unsigned seed);
+
+#endif //COLLISIONSIM_WORKLOAD_H
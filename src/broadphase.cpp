@@ -0,0 +1,108 @@
+//
+// Created by Trebing, Peter on 2019-09-18.
+//
+
+#include <algorithm>
+#include "broadphase.h"
+
+void Broadphase::findAllPairs(const std::vector<Box> &boxes, std::vector<Pair> &pairs) {
+    allRows.resize(boxes.size());
+    for (std::size_t i = 0; i < allRows.size(); i++) allRows[i] = static_cast<uint32_t>(i);
+    findPairs(boxes, allRows, CollisionBudget(), pairs);
+}
+
+std::size_t BruteForceBroadphase::findPairs(const std::vector<Box> &boxes, const std::vector<uint32_t> &rows,
+                                            const CollisionBudget &budget, std::vector<Pair> &pairs) {
+
+    pairs.clear();
+
+    // Count helps to fulfill the maximum collision limit
+    std::size_t checkCount = 0;
+    uint32_t n = static_cast<uint32_t>(boxes.size());
+
+    for (std::size_t done = 0; done < rows.size(); done++) {
+        if (budget.exhausted(checkCount, done)) return done;
+        uint32_t i = rows[done];
+        checkCount += n;
+        for (uint32_t j = 0; j < n; j++) {
+            if (i == j) continue; // do not collide box with itself
+            if (hasIntersection(boxes[i], boxes[j])) {
+                pairs.push_back(Pair{i, j});
+            }
+        }
+    }
+    return rows.size();
+}
+
+std::size_t UniformGridBroadphase::findPairs(const std::vector<Box> &boxes, const std::vector<uint32_t> &rows,
+                                             const CollisionBudget &budget, std::vector<Pair> &pairs) {
+
+    pairs.clear();
+    uint32_t n = static_cast<uint32_t>(boxes.size());
+    if (n == 0) return rows.size();
+
+    // the grid covers the upper left corners of all boxes
+    double minX = boxes[0].l.x, minY = boxes[0].l.y, maxX = minX, maxY = minY;
+    double cellSize = 1.0;
+    for (const Box &box: boxes) {
+        minX = std::min(minX, box.l.x);
+        minY = std::min(minY, box.l.y);
+        maxX = std::max(maxX, box.l.x);
+        maxY = std::max(maxY, box.l.y);
+        cellSize = std::max(cellSize, std::max(box.r.x - box.l.x, box.r.y - box.l.y));
+    }
+    // limit the number of cells to a few per box, sparse boxes get larger cells
+    while (((maxX - minX) / cellSize + 1.0) * ((maxY - minY) / cellSize + 1.0) > 4.0 * n + 16.0) cellSize *= 2.0;
+    uint32_t columns = static_cast<uint32_t>((maxX - minX) / cellSize) + 1;
+    uint32_t gridRows = static_cast<uint32_t>((maxY - minY) / cellSize) + 1;
+
+    // counting sort of the boxes by the cell of their upper left corner
+    cellStart.assign(static_cast<std::size_t>(columns) * gridRows + 1, 0);
+    boxCell.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t column = static_cast<uint32_t>((boxes[i].l.x - minX) / cellSize);
+        uint32_t row = static_cast<uint32_t>((boxes[i].l.y - minY) / cellSize);
+        boxCell[i] = row * columns + column;
+        ++cellStart[boxCell[i] + 1];
+    }
+    for (std::size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    cellItems.resize(n);
+    cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t i = 0; i < n; i++) cellItems[cellFill[boxCell[i]]++] = i;
+
+    // A box overlapping box i starts at most one cell before it, as no box is larger than
+    // a cell, so the 3x3 cells around the cell of i hold all candidates
+    std::size_t checkCount = 0;
+    for (std::size_t done = 0; done < rows.size(); done++) {
+        if (budget.exhausted(checkCount, done)) return done;
+        uint32_t i = rows[done];
+        uint32_t column = boxCell[i] % columns;
+        uint32_t row = boxCell[i] / columns;
+        candidates.clear();
+        for (uint32_t r = row > 0 ? row - 1 : 0; r <= row + 1 && r < gridRows; r++) {
+            for (uint32_t c = column > 0 ? column - 1 : 0; c <= column + 1 && c < columns; c++) {
+                uint32_t cell = r * columns + c;
+                for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+                    uint32_t j = cellItems[k];
+                    ++checkCount;
+                    if (i != j && hasIntersection(boxes[i], boxes[j])) candidates.push_back(j);
+                }
+            }
+        }
+        // same order as the brute force
+        std::sort(candidates.begin(), candidates.end());
+        for (uint32_t j: candidates) pairs.push_back(Pair{i, j});
+    }
+    return rows.size();
+}
+
+const std::vector<std::string> &broadphaseNames() {
+    static const std::vector<std::string> names{"bruteforce", "grid"};
+    return names;
+}
+
+std::unique_ptr<Broadphase> createBroadphase(const std::string &name) {
+    if (name == "bruteforce") return std::unique_ptr<Broadphase>(new BruteForceBroadphase());
+    if (name == "grid") return std::unique_ptr<Broadphase>(new UniformGridBroadphase());
+    return nullptr;
+}
@@ -0,0 +1,127 @@
+//
+// Created by Trebing, Peter on 2019-09-18.
+//
+
+#ifndef COLLISIONSIM_BROADPHASE_H
+#define COLLISIONSIM_BROADPHASE_H
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "collision.h"
+
+/**
+ * A candidate pair of colliding objects, given as indices into the list of boxes
+ */
+struct Pair {
+    uint32_t i;
+    uint32_t j;
+};
+
+/**
+ * Limits the work of one collision pass by a number of pair checks and a deadline. The
+ * budget is checked before every row, i.e. before the pairs of a box are searched, and at
+ * least one row is always processed, so every pass makes progress.
+ */
+struct CollisionBudget {
+    std::size_t checks;
+    std::chrono::steady_clock::time_point deadline;
+    bool hasDeadline;
+
+    CollisionBudget() : checks(std::numeric_limits<std::size_t>::max()), hasDeadline(false) {}
+
+    /**
+     * Returns true, if no further row may be started
+     */
+    bool exhausted(std::size_t checkCount, std::size_t rowsDone) const {
+        if (rowsDone == 0) return false;
+        if (checkCount >= checks) return true;
+        // reading the clock costs more than the check of a few boxes
+        return hasDeadline && rowsDone % 16 == 0 && std::chrono::steady_clock::now() >= deadline;
+    }
+};
+
+/**
+ * The broad phase finds the pairs of boxes which overlap. It works on a snapshot of the
+ * bounding boxes, so it can run without holding the lock of the simulated objects.
+ */
+class Broadphase {
+
+public:
+
+    virtual ~Broadphase() {};
+
+    /**
+     * Finds the boxes overlapping the boxes of the given rows, row by row until the budget
+     * is exhausted. The pairs of a row are emitted in ascending order of j.
+     * @param boxes bounding boxes of all objects
+     * @param rows indices of the boxes to search the pairs (i, j) for, in this order
+     * @param pairs receives the overlapping pairs (i, j) of the processed rows
+     * @return the number of processed rows, i.e. rows[0..result) are complete
+     */
+    virtual std::size_t findPairs(const std::vector<Box> &boxes, const std::vector<uint32_t> &rows,
+                                  const CollisionBudget &budget, std::vector<Pair> &pairs) = 0;
+
+    /**
+     * Finds all overlapping boxes without a budget, both (i, j) and (j, i), ordered by i and j
+     */
+    void findAllPairs(const std::vector<Box> &boxes, std::vector<Pair> &pairs);
+
+    virtual const char *getName() = 0;
+
+private:
+    std::vector<uint32_t> allRows;
+};
+
+/**
+ * Checks every box against every other box - O(n^2)
+ */
+class BruteForceBroadphase : public Broadphase {
+
+public:
+
+    std::size_t findPairs(const std::vector<Box> &boxes, const std::vector<uint32_t> &rows,
+                          const CollisionBudget &budget, std::vector<Pair> &pairs);
+
+    const char *getName() { return "bruteforce"; }
+};
+
+/**
+ * Sorts the boxes into a uniform grid with cells the size of the largest box, so every box
+ * is only checked against the boxes of its own and the 8 neighbouring cells - O(n) for a
+ * bounded density. The pairs are emitted in the same order as by the brute force, so the
+ * collisions are resolved in the same order as well.
+ */
+class UniformGridBroadphase : public Broadphase {
+
+public:
+
+    std::size_t findPairs(const std::vector<Box> &boxes, const std::vector<uint32_t> &rows,
+                          const CollisionBudget &budget, std::vector<Pair> &pairs);
+
+    const char *getName() { return "grid"; }
+
+private:
+    // cells as compressed rows: the boxes of cell c are cellItems[cellStart[c]..cellStart[c + 1])
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellItems;
+    std::vector<uint32_t> cellFill;
+    std::vector<uint32_t> boxCell;
+    std::vector<uint32_t> candidates;
+};
+
+/**
+ * Names of all broad phases, the first one is the reference
+ */
+const std::vector<std::string> &broadphaseNames();
+
+/**
+ * Creates a broad phase by its name
+ * @return nullptr, if the name is unknown
+ */
+std::unique_ptr<Broadphase> createBroadphase(const std::string &name);
+
+#endif //COLLISIONSIM_BROADPHASE_H
@@ -0,0 +1,197 @@
+//
+// Created by Trebing, Peter on 2019-09-14.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include "checkpoint.h"
+#include "tracer.h"
+
+const uint32_t Checkpoint::VERSION = 1;
+
+namespace {
+
+const char MAGIC[8] = {'C', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Rounds offset up to the next multiple of 8
+uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+// True, if the section [offset, offset + size) lies within the file, without overflow
+bool inside(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+/**
+ * Checks that every section of the header lies within the file and that the columns
+ * follow each other as written, so the getters never read beyond the mapping
+ */
+bool validSections(const CheckpointHeader &header) {
+    uint64_t size = header.fileSize;
+    uint64_t n = header.particleCount;
+    uint64_t column = 2 * sizeof(double);
+    if (n > size / (2 * column)) return false;
+    return inside(header.configOffset, header.configSize, size) &&
+           inside(header.rngOffset, header.rngSize, size) &&
+           header.positionOffset % sizeof(double) == 0 &&
+           inside(header.positionOffset, 2 * column * n, size) &&
+           header.velocityOffset == header.positionOffset + column * n &&
+           header.speciesOffset == header.positionOffset + 2 * column * n &&
+           inside(header.speciesOffset, n, size);
+}
+
+void writeAt(std::ofstream &out, uint64_t offset, const void *data, uint64_t size) {
+    out.seekp(static_cast<std::streamoff>(offset));
+    out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+}
+
+}
+
+std::unique_ptr<CheckpointSnapshot> Checkpoint::capture(SimulationObjects &objects,
+                                                        const std::string &configuration,
+                                                        const std::string &rngState) {
+    std::unique_ptr<CheckpointSnapshot> snapshot = std::make_unique<CheckpointSnapshot>();
+    snapshot->configuration = configuration;
+    snapshot->rngState = rngState;
+
+    static LockSite site("Checkpoint::capture");
+    CheckpointSnapshot *s = snapshot.get();
+    std::size_t expected = objects.size(&site);
+    s->positionX.reserve(expected);
+    s->positionY.reserve(expected);
+    s->velocityX.reserve(expected);
+    s->velocityY.reserve(expected);
+    s->species.reserve(expected);
+    objects.map([s](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        const Particle &part = obj->getParticle();
+        Vector3 position = part.getPosition();
+        Vector3 velocity = part.getVelocity();
+        s->positionX.push_back(position.x);
+        s->positionY.push_back(position.y);
+        s->velocityX.push_back(velocity.x);
+        s->velocityY.push_back(velocity.y);
+        s->species.push_back(static_cast<uint8_t>(obj->getSpecies()));
+        return false;
+    }, &site);
+    return snapshot;
+}
+
+bool Checkpoint::write(const CheckpointSnapshot &snapshot, const std::string &filename) {
+
+    uint64_t count = snapshot.positionX.size();
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.particleCount = count;
+    header.configOffset = align8(sizeof(CheckpointHeader));
+    header.configSize = snapshot.configuration.size();
+    header.rngOffset = align8(header.configOffset + header.configSize);
+    header.rngSize = snapshot.rngState.size();
+    header.positionOffset = align8(header.rngOffset + header.rngSize);
+    header.velocityOffset = header.positionOffset + 2 * count * sizeof(double);
+    header.speciesOffset = header.velocityOffset + 2 * count * sizeof(double);
+    header.fileSize = header.speciesOffset + count;
+
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Couldn't open " << temporary << " for writing.\n";
+            return false;
+        }
+        writeAt(out, 0, &header, sizeof(header));
+        writeAt(out, header.configOffset, snapshot.configuration.data(), header.configSize);
+        writeAt(out, header.rngOffset, snapshot.rngState.data(), header.rngSize);
+        writeAt(out, header.positionOffset, snapshot.positionX.data(), count * sizeof(double));
+        out.write(reinterpret_cast<const char *>(snapshot.positionY.data()), count * sizeof(double));
+        out.write(reinterpret_cast<const char *>(snapshot.velocityX.data()), count * sizeof(double));
+        out.write(reinterpret_cast<const char *>(snapshot.velocityY.data()), count * sizeof(double));
+        out.write(reinterpret_cast<const char *>(snapshot.species.data()), count);
+        out.flush();
+        if (!out.good()) {
+            std::cerr << "Couldn't write checkpoint " << temporary << ".\n";
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Couldn't rename " << temporary << " to " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Checkpoint> Checkpoint::open(const std::string &filename) {
+
+    std::unique_ptr<Checkpoint> checkpoint(new Checkpoint());
+    if (!checkpoint->file.open(filename)) return nullptr;
+
+    if (checkpoint->file.size() < sizeof(CheckpointHeader)) {
+        std::cerr << filename << " is not a checkpoint file.\n";
+        return nullptr;
+    }
+    const CheckpointHeader *header = reinterpret_cast<const CheckpointHeader *>(checkpoint->file.getData());
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->byteOrder != BYTE_ORDER_MARK) {
+        std::cerr << filename << " is not a checkpoint file of this platform.\n";
+        return nullptr;
+    }
+    if (header->version != VERSION) {
+        std::cerr << "Checkpoint version " << header->version << " is not supported (expected "
+                  << VERSION << ").\n";
+        return nullptr;
+    }
+    if (header->fileSize != checkpoint->file.size() ||
+        header->speciesOffset + header->particleCount != header->fileSize) {
+        std::cerr << "Checkpoint " << filename << " is truncated.\n";
+        return nullptr;
+    }
+    if (!validSections(*header)) {
+        std::cerr << "Checkpoint " << filename << " is corrupt.\n";
+        return nullptr;
+    }
+    checkpoint->header = header;
+    return checkpoint;
+}
+
+std::string Checkpoint::getConfiguration() const {
+    return std::string(column<char>(header->configOffset), header->configSize);
+}
+
+std::string Checkpoint::getRngState() const {
+    return std::string(column<char>(header->rngOffset), header->rngSize);
+}
+
+void CheckpointWriter::run() {
+    while (stopRequested() == false) {
+        // sleep at every iteration to reduce CPU usage
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        writePending();
+    }
+    // the final snapshot may have been submitted right before the stop request
+    writePending();
+}
+
+void CheckpointWriter::submit(std::unique_ptr<CheckpointSnapshot> snapshot) {
+    std::lock_guard<std::mutex> uLock(_mutex);
+    pending = std::move(snapshot);
+}
+
+void CheckpointWriter::writePending() {
+    std::unique_ptr<CheckpointSnapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        snapshot = std::move(pending);
+    }
+    if (!snapshot) return;
+    TraceScope trace("checkpoint write");
+    if (Checkpoint::write(*snapshot, filename)) {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        ++written;
+    }
+}
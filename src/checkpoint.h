@@ -0,0 +1,153 @@
+//
+// Created by Trebing, Peter on 2019-09-14.
+//
+
+#ifndef COLLISIONSIM_CHECKPOINT_H
+#define COLLISIONSIM_CHECKPOINT_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "simulationObject.h"
+#include "mappedFile.h"
+#include "stoppable.h"
+
+/**
+ * Fixed size header at the very beginning of a checkpoint file. All sections are
+ * stored behind the header at 8 byte aligned offsets, particle data in columns
+ * (structure of arrays), so that a mapped file can be used without any copying.
+ */
+struct CheckpointHeader {
+    char magic[8];              // "CSIMCKPT"
+    uint32_t version;           // format version, see Checkpoint::VERSION
+    uint32_t byteOrder;         // 0x01020304 written in native byte order
+    uint64_t particleCount;
+    uint64_t configOffset;      // configuration as text (key=value lines)
+    uint64_t configSize;
+    uint64_t rngOffset;         // random engine state as text
+    uint64_t rngSize;
+    uint64_t positionOffset;    // double x[n], double y[n]
+    uint64_t velocityOffset;    // double x[n], double y[n]
+    uint64_t speciesOffset;     // uint8_t species[n]
+    uint64_t fileSize;
+};
+
+/**
+ * Copy of the complete simulation state, taken under the lock of the simulated objects.
+ * It is owned by the checkpoint writer afterwards, so the file can be written without
+ * holding any lock.
+ */
+struct CheckpointSnapshot {
+    std::string configuration;
+    std::string rngState;
+    std::vector<double> positionX;
+    std::vector<double> positionY;
+    std::vector<double> velocityX;
+    std::vector<double> velocityY;
+    std::vector<uint8_t> species;
+};
+
+/**
+ * A binary, versioned checkpoint of the simulation state. Checkpoints are written from
+ * snapshots and loaded by mapping the file into memory.
+ */
+class Checkpoint {
+
+public:
+
+    static const uint32_t VERSION;
+
+    /**
+     * Copies the state of all simulated objects in a single pass
+     * @param objects the simulated objects
+     * @param configuration configuration to be stored along with the particles
+     * @param rngState serialized state of the random engine
+     */
+    static std::unique_ptr<CheckpointSnapshot> capture(SimulationObjects &objects,
+                                                       const std::string &configuration,
+                                                       const std::string &rngState);
+
+    /**
+     * Writes a snapshot to a temporary file and renames it to filename afterwards,
+     * so a crash while writing never destroys the last good checkpoint.
+     * @return false if the file could not be written
+     */
+    static bool write(const CheckpointSnapshot &snapshot, const std::string &filename);
+
+    /**
+     * Maps a checkpoint file into memory and validates its header
+     * @return nullptr if the file does not exist or is not a valid checkpoint
+     */
+    static std::unique_ptr<Checkpoint> open(const std::string &filename);
+
+    std::size_t getParticleCount() const { return header->particleCount; }
+
+    std::string getConfiguration() const;
+
+    std::string getRngState() const;
+
+    const double *getPositionX() const { return column<double>(header->positionOffset); }
+
+    const double *getPositionY() const { return getPositionX() + header->particleCount; }
+
+    const double *getVelocityX() const { return column<double>(header->velocityOffset); }
+
+    const double *getVelocityY() const { return getVelocityX() + header->particleCount; }
+
+    const uint8_t *getSpecies() const { return column<uint8_t>(header->speciesOffset); }
+
+private:
+
+    Checkpoint() : header(nullptr) {}
+
+    template<typename C>
+    const C *column(uint64_t offset) const {
+        return reinterpret_cast<const C *>(file.getData() + offset);
+    }
+
+    MappedFile file;
+    const CheckpointHeader *header;
+};
+
+/**
+ * Writes checkpoints in its own thread. Snapshots are handed over by submit, only the
+ * most recent one is kept if the writer cannot keep up.
+ */
+class CheckpointWriter : public Stoppable {
+
+public:
+
+    CheckpointWriter(std::string filename) : Stoppable(), filename(filename), written(0) {}
+
+    /**
+     * Writes the pending snapshot whenever one is available.
+     * This method is intended to be used in its own thread
+     */
+    void run();
+
+    /**
+     * Hands a snapshot over to the writer thread
+     */
+    void submit(std::unique_ptr<CheckpointSnapshot> snapshot);
+
+    /**
+     * Returns the number of checkpoints written so far
+     */
+    std::size_t getWrittenCount() {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        return written;
+    }
+
+private:
+
+    void writePending();
+
+    std::mutex _mutex;
+    std::unique_ptr<CheckpointSnapshot> pending;
+    std::string filename;
+    std::size_t written;
+};
+
+#endif //COLLISIONSIM_CHECKPOINT_H
@@ -0,0 +1,155 @@
+//
+// Created by Trebing, Peter on 2019-08-27.
+//
+
+#ifndef COLLISIONSIM_COLLISION_H
+#define COLLISIONSIM_COLLISION_H
+
+#include <algorithm>
+#include <cmath>
+#include "mathtools.h"
+#include "simulationObject.h"
+
+// Representation of a point in 2D
+struct Point {
+    double x, y;
+};
+
+// Axis aligned bounding box of a simulation object
+struct Box {
+    Point l; // left upper point
+    Point r; // right lower point
+};
+
+/** Checks if two rectangles do intersect - used to check for collision
+ * @param l1 left upper point of rechtangle 1
+ * @param r1 right lower point of rechtangle 1
+ * @param l2 left upper point of rechtangle 2
+ * @param r2 right lower point of rechtangle 2
+ */
+inline bool hasIntersection(Point l1, Point r1, Point l2, Point r2) {
+
+    // If one rectangle is on left side of other
+    if (l1.x > r2.x || l2.x > r1.x)
+        return false;
+
+    // If one rectangle is above other
+    if (l1.y > r2.y || l2.y > r1.y)
+        return false;
+
+    return true;
+}
+
+inline bool hasIntersection(const Box &b1, const Box &b2) {
+    return hasIntersection(b1.l, b1.r, b2.l, b2.r);
+}
+
+/**
+ * Returns the box enclosing both boxes, e.g. the area swept by a moving box
+ */
+inline Box merge(const Box &a, const Box &b) {
+    return Box{{std::min(a.l.x, b.l.x), std::min(a.l.y, b.l.y)}, {std::max(a.r.x, b.r.x), std::max(a.r.y, b.r.y)}};
+}
+
+/**
+ * Returns the box moved by the given vector
+ */
+inline Box translate(const Box &box, const Vector3 &move) {
+    return Box{{box.l.x + move.x, box.l.y + move.y}, {box.r.x + move.x, box.r.y + move.y}};
+}
+
+/**
+ * Computes when two linearly moving boxes touch first (swept AABB test). Box a moves by
+ * moveA, box b by moveB within the same time.
+ * @return the fraction 0..1 of the motion at which the boxes touch, 0 if they intersect
+ * at the start, or a negative value if they do not touch at all
+ */
+inline double timeOfImpact(const Box &a, const Vector3 &moveA, const Box &b, const Vector3 &moveB) {
+
+    // move a relative to b, one slab per axis
+    double d[2] = {moveA.x - moveB.x, moveA.y - moveB.y};
+    double aMin[2] = {a.l.x, a.l.y}, aMax[2] = {a.r.x, a.r.y};
+    double bMin[2] = {b.l.x, b.l.y}, bMax[2] = {b.r.x, b.r.y};
+    double enter = 0.0, exit = 1.0;
+    for (int axis = 0; axis < 2; axis++) {
+        if (d[axis] == 0.0) {
+            if (aMin[axis] > bMax[axis] || bMin[axis] > aMax[axis]) return -1.0;
+            continue;
+        }
+        double t1 = (bMin[axis] - aMax[axis]) / d[axis];
+        double t2 = (bMax[axis] - aMin[axis]) / d[axis];
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+        if (enter > exit) return -1.0;
+    }
+    return enter;
+}
+
+/**
+ * Computes the necessary displacement of two rectangles after collsion - to prevent
+ * detecting a collision over and over again
+ * @param l1 left upper point of rechtangle 1
+ * @param r1 right lower point of rechtangle 1
+ * @param l2 left upper point of rechtangle 3
+ * @param r2 right lower point of rechtangle 2
+ * @return a vector instance representing  the displacement in component x and y (z will always be 0)
+ */
+inline Vector3 getDisplacement(Point l1, Point r1, Point l2, Point r2) {
+
+    Vector3 result;
+
+    result.x = (std::min(r1.x, r2.x) -
+                std::max(l1.x, l2.x));
+
+    result.y = (std::min(r1.y, r2.y) -
+                std::max(l1.y, l2.y));
+
+    result.z = 0;
+    return result;
+}
+
+/**
+ * Elastic collision of two masses: the velocity components along the normal are exchanged,
+ * the tangential ones are kept. Find the math in
+ * https://imada.sdu.dk/~rolf/Edu/DM815/E10/2dcollisions.pdf
+ * @param unitNormal direction of the impact, its sign does not matter
+ * @return false and leaves the velocities unchanged, if the result is undefined,
+ * e.g. for a normal of coinciding positions
+ */
+inline bool elasticCollision(Vector3 &v1, double m1, Vector3 &v2, double m2, const Vector3 &unitNormal) {
+
+    Vector3 unitTangent = Vector3(-unitNormal.y, unitNormal.x, 0.0f);
+
+    // Dot Product Tangent
+    double v1t = v1.scalarProduct(unitTangent);
+    if (std::isnan(v1t)) return false;
+    double v2t = v2.scalarProduct(unitTangent);
+    if (std::isnan(v2t)) return false;
+
+    // Dot Product Normal
+    double v1n = v1.scalarProduct(unitNormal);
+    if (std::isnan(v1n)) return false;
+    double v2n = v2.scalarProduct(unitNormal);
+    if (std::isnan(v2n)) return false;
+
+    double m1addm2 = m1 + m2;
+    double v1nNext = (v1n * (m1 - m2) + 2.0f * m2 * v2n) / m1addm2;
+    if (std::isnan(v1nNext)) return false;
+    double v2nNext = (v2n * (m2 - m1) + 2.0f * m1 * v1n) / m1addm2;
+    if (std::isnan(v2nNext)) return false;
+
+    v1 = unitNormal * v1nNext + unitTangent * v1t;
+    v2 = unitNormal * v2nNext + unitTangent * v2t;
+    return true;
+}
+
+/**
+ * Returns the bounding box of a simulation object at its current position
+ */
+inline Box getBox(SimulationObject &obj) {
+    Vector3 p = obj.getParticle().getPosition();
+    double size = static_cast<double>(obj.getSize());
+    return Box{{p.x, p.y}, {p.x + size, p.y + size}};
+}
+
+#endif //COLLISIONSIM_COLLISION_H
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <unordered_map>
 
@@ -20,16 +21,7 @@ public:
 
     Configuration() {
         load();
-        fps = getIntParameter("fps");
-        window_width = getIntParameter("window_width");
-        window_height = getIntParameter("window_height");
-        physic_interval_ms = getIntParameter("physic_interval_ms");
-        particle_count = getIntParameter("particle_count");
-        particle_render_limit = getIntParameter("particle_render_limit");
-        particle_velocity_range = getFloatParameter("particle_velocity_range");
-        damping = getFloatParameter("damping");
-        gravity_factor = getFloatParameter("gravity_factor");
-        collision_limit = getIntParameter("collision_limit");
+        update();
     }
 
     /**
@@ -60,6 +52,60 @@ public:
         };
     };
 
+    /**
+     * Returns all key value pairs in the format of the configuration file
+     */
+    std::string toString() {
+        std::ostringstream out;
+        for (auto &entry: keyValuesPairs) {
+            out << entry.first << "=" << entry.second << '\n';
+        }
+        return out.str();
+    }
+
+    /**
+     * Overwrites the key value pairs with the ones contained in text and refreshes
+     * all attributes.
+     * @param text key value pairs in the format of the configuration file
+     * @param keepPrefix keys starting with this prefix are not overwritten
+     */
+    void merge(const std::string &text, const std::string &keepPrefix = "") {
+        std::istringstream in(text);
+        std::string line;
+        while (getline(in, line)) {
+            line.erase(std::remove_if(line.begin(), line.end(), isspace),
+                       line.end());
+            if (line.empty() || line[0] == '#')
+                continue;
+            if (!keepPrefix.empty() && line.compare(0, keepPrefix.size(), keepPrefix) == 0)
+                continue;
+            auto delimiterPos = line.find("=");
+            keyValuesPairs[line.substr(0, delimiterPos)] = line.substr(delimiterPos + 1);
+        }
+        update();
+    }
+
+    /**
+     * Collects command line arguments of the form key=value in the format of the
+     * configuration file, to be applied by merge
+     * @param overrides receives the key value pairs
+     * @return false, if an argument is not of this form
+     */
+    static bool parseArguments(int argc, char **argv, std::string &overrides) {
+        std::ostringstream out;
+        for (int i = 1; i < argc; i++) {
+            std::string argument(argv[i]);
+            auto delimiterPos = argument.find("=");
+            if (delimiterPos == std::string::npos || delimiterPos == 0) {
+                std::cerr << "Invalid argument " << argument << ", expected key=value.\n";
+                return false;
+            }
+            out << argument << '\n';
+        }
+        overrides = out.str();
+        return true;
+    }
+
     // Getter and Setters for all configuration attributes
     std::size_t getFPS() { return fps; }
 
@@ -89,6 +135,22 @@ public:
 
     void setCollisionLimit(std::size_t limit) { collision_limit = limit; }
 
+    std::size_t getCollisionBudgetUs() { return collision_budget_us; }
+
+    void setCollisionBudgetUs(std::size_t budget) { collision_budget_us = budget; }
+
+    std::string getPhysicsEngine() { return physics_engine; }
+
+    void setPhysicsEngine(std::string name) { physics_engine = name; }
+
+    double getDsmcCellSize() { return dsmc_cell_size; }
+
+    void setDsmcCellSize(double size) { dsmc_cell_size = size; }
+
+    std::string getBroadphase() { return broadphase; }
+
+    void setBroadphase(std::string name) { broadphase = name; }
+
     double getParticleVelocityRange() { return particle_velocity_range; }
 
     void setParticleVelocityRange(double range) { particle_velocity_range = range; }
@@ -101,10 +163,165 @@ public:
 
     void setGravityFactor(double factor) { gravity_factor = factor; }
 
+    double getCcdThreshold() { return ccd_threshold; }
+
+    void setCcdThreshold(double threshold) { ccd_threshold = threshold; }
+
+    double getLjEpsilon() { return lj_epsilon; }
+
+    void setLjEpsilon(double epsilon) { lj_epsilon = epsilon; }
+
+    double getLjCutoff() { return lj_cutoff; }
+
+    void setLjCutoff(double cutoff) { lj_cutoff = cutoff; }
+
+    double getLjSkin() { return lj_skin; }
+
+    void setLjSkin(double skin) { lj_skin = skin; }
+
+    std::string getIntegrator() { return integrator; }
+
+    void setIntegrator(std::string name) { integrator = name; }
+
+    double getTimestepCfl() { return timestep_cfl; }
+
+    void setTimestepCfl(double cfl) { timestep_cfl = cfl; }
+
+    bool getTimestepMultirate() { return timestep_multirate; }
+
+    void setTimestepMultirate(bool enabled) { timestep_multirate = enabled; }
+
+    double getTimestepMaxMs() { return timestep_max_ms; }
+
+    void setTimestepMaxMs(double ms) { timestep_max_ms = ms; }
+
+    std::size_t getTimestepMaxSubsteps() { return timestep_max_substeps; }
+
+    void setTimestepMaxSubsteps(std::size_t substeps) { timestep_max_substeps = substeps; }
+
+    double getSleepEpsilon() { return sleep_epsilon; }
+
+    void setSleepEpsilon(double epsilon) { sleep_epsilon = epsilon; }
+
+    std::size_t getWorkerThreads() { return worker_threads; }
+
+    void setWorkerThreads(std::size_t threads) { worker_threads = threads; }
+
+    bool getProfiling() { return profiling; }
+
+    void setProfiling(bool enabled) { profiling = enabled; }
+
+    std::size_t getProfileLogIntervalS() { return profile_log_interval_s; }
+
+    void setProfileLogIntervalS(std::size_t interval) { profile_log_interval_s = interval; }
+
+    bool getLockProfiling() { return lock_profiling; }
+
+    void setLockProfiling(bool enabled) { lock_profiling = enabled; }
+
+    bool getPerfCounters() { return perf_counters; }
+
+    void setPerfCounters(bool enabled) { perf_counters = enabled; }
+
+    std::string getTraceFile() { return trace_file; }
+
+    void setTraceFile(std::string filename) { trace_file = filename; }
+
+    std::size_t getTraceBufferEvents() { return trace_buffer_events; }
+
+    void setTraceBufferEvents(std::size_t events) { trace_buffer_events = events; }
+
+    std::string getCheckpointFile() { return checkpoint_file; }
+
+    void setCheckpointFile(std::string filename) { checkpoint_file = filename; }
+
+    std::size_t getCheckpointIntervalS() { return checkpoint_interval_s; }
+
+    void setCheckpointIntervalS(std::size_t interval) { checkpoint_interval_s = interval; }
+
+    bool getCheckpointRestore() { return checkpoint_restore; }
+
+    void setCheckpointRestore(bool restore) { checkpoint_restore = restore; }
+
+    std::string getTrajectoryFile() { return trajectory_file; }
+
+    void setTrajectoryFile(std::string filename) { trajectory_file = filename; }
+
+    std::size_t getTrajectoryStride() { return trajectory_stride; }
+
+    void setTrajectoryStride(std::size_t stride) { trajectory_stride = stride; }
+
+    std::size_t getTrajectoryResolution() { return trajectory_resolution; }
+
+    void setTrajectoryResolution(std::size_t resolution) { trajectory_resolution = resolution; }
+
+    std::size_t getTrajectoryChunkFrames() { return trajectory_chunk_frames; }
+
+    void setTrajectoryChunkFrames(std::size_t frames) { trajectory_chunk_frames = frames; }
+
+    std::size_t getTrajectoryBufferFrames() { return trajectory_buffer_frames; }
+
+    void setTrajectoryBufferFrames(std::size_t frames) { trajectory_buffer_frames = frames; }
+
+    std::string getReplayFile() { return replay_file; }
+
+    void setReplayFile(std::string filename) { replay_file = filename; }
+
+    std::size_t getReplayFps() { return replay_fps; }
+
+    void setReplayFps(std::size_t fps) { replay_fps = fps; }
+
 private:
 
     std::unordered_map<std::string, std::string> keyValuesPairs;
 
+    /**
+     * Refreshes all attributes from the key value pairs
+     */
+    void update() {
+        fps = getIntParameter("fps");
+        window_width = getIntParameter("window_width");
+        window_height = getIntParameter("window_height");
+        physic_interval_ms = getIntParameter("physic_interval_ms");
+        particle_count = getIntParameter("particle_count");
+        particle_render_limit = getIntParameter("particle_render_limit");
+        particle_velocity_range = getFloatParameter("particle_velocity_range");
+        damping = getFloatParameter("damping");
+        gravity_factor = getFloatParameter("gravity_factor");
+        collision_limit = getIntParameter("collision_limit");
+        collision_budget_us = getIntParameter("collision_budget_us", 0);
+        physics_engine = getStringParameter("physics_engine", "time_step");
+        dsmc_cell_size = getFloatParameter("dsmc_cell_size", 20.0);
+        broadphase = getStringParameter("broadphase", "bruteforce");
+        integrator = getStringParameter("integrator", "euler");
+        ccd_threshold = getFloatParameter("ccd_threshold", 0.0);
+        lj_epsilon = getFloatParameter("lj_epsilon", 0.0);
+        lj_cutoff = getFloatParameter("lj_cutoff", 2.5);
+        lj_skin = getFloatParameter("lj_skin", 4.0);
+        timestep_cfl = getFloatParameter("timestep_cfl", 0.0);
+        timestep_max_ms = getFloatParameter("timestep_max_ms", 20.0);
+        timestep_multirate = getIntParameter("timestep_multirate", 0) != 0;
+        timestep_max_substeps = getIntParameter("timestep_max_substeps", 16);
+        sleep_epsilon = getFloatParameter("sleep_epsilon", 0.0);
+        worker_threads = getIntParameter("worker_threads", 0);
+        profiling = getIntParameter("profiling", 1) != 0;
+        profile_log_interval_s = getIntParameter("profile_log_interval_s", 10);
+        lock_profiling = getIntParameter("lock_profiling", 1) != 0;
+        perf_counters = getIntParameter("perf_counters", 0) != 0;
+        trace_file = getStringParameter("trace_file", "");
+        trace_buffer_events = getIntParameter("trace_buffer_events", 65536);
+        checkpoint_file = getStringParameter("checkpoint_file", "checkpoint.bin");
+        checkpoint_interval_s = getIntParameter("checkpoint_interval_s", 0);
+        checkpoint_restore = getIntParameter("checkpoint_restore", 0) != 0;
+        trajectory_file = getStringParameter("trajectory_file", "");
+        trajectory_stride = getIntParameter("trajectory_stride", 10);
+        trajectory_resolution = getIntParameter("trajectory_resolution", 16);
+        trajectory_chunk_frames = getIntParameter("trajectory_chunk_frames", 64);
+        trajectory_buffer_frames = getIntParameter("trajectory_buffer_frames", 8);
+        replay_file = getStringParameter("replay_file", "");
+        replay_fps = getIntParameter("replay_fps", 30);
+    }
+
     std::string getParameter(std::string key) {
         auto entry = keyValuesPairs.find(key);
         if (entry == keyValuesPairs.end())
@@ -123,6 +340,23 @@ private:
         return std::stod(found);
     };
 
+    // Variants for optional parameters, returning defaultValue if key is missing
+
+    std::string getStringParameter(std::string key, std::string defaultValue) {
+        auto entry = keyValuesPairs.find(key);
+        return entry == keyValuesPairs.end() ? defaultValue : entry->second;
+    };
+
+    std::size_t getIntParameter(std::string key, std::size_t defaultValue) {
+        auto entry = keyValuesPairs.find(key);
+        return entry == keyValuesPairs.end() ? defaultValue : std::stoi(entry->second);
+    };
+
+    double getFloatParameter(std::string key, double defaultValue) {
+        auto entry = keyValuesPairs.find(key);
+        return entry == keyValuesPairs.end() ? defaultValue : std::stod(entry->second);
+    };
+
     std::size_t fps;
     std::size_t window_width;
     std::size_t window_height;
@@ -130,9 +364,40 @@ private:
     std::size_t particle_count;
     std::size_t particle_render_limit;
     std::size_t collision_limit;
+    std::size_t collision_budget_us;
+    std::string physics_engine;
+    double dsmc_cell_size;
+    std::string broadphase;
     double particle_velocity_range;
     double damping;
     double gravity_factor;
+    std::string integrator;
+    double ccd_threshold;
+    double lj_epsilon;
+    double lj_cutoff;
+    double lj_skin;
+    double timestep_cfl;
+    double timestep_max_ms;
+    bool timestep_multirate;
+    std::size_t timestep_max_substeps;
+    double sleep_epsilon;
+    std::size_t worker_threads;
+    bool profiling;
+    std::size_t profile_log_interval_s;
+    bool lock_profiling;
+    bool perf_counters;
+    std::string trace_file;
+    std::size_t trace_buffer_events;
+    std::string checkpoint_file;
+    std::size_t checkpoint_interval_s;
+    bool checkpoint_restore;
+    std::string trajectory_file;
+    std::size_t trajectory_stride;
+    std::size_t trajectory_resolution;
+    std::size_t trajectory_chunk_frames;
+    std::size_t trajectory_buffer_frames;
+    std::string replay_file;
+    std::size_t replay_fps;
 
 };
 
@@ -0,0 +1,46 @@
+//
+// Created by Trebing, Peter on 2019-10-01.
+//
+
+#include <utility>
+#include "contactManager.h"
+
+void ContactManager::beginPass() {
+    ++pass;
+    events.clear();
+}
+
+bool ContactManager::touch(uint32_t i, uint32_t j, uint64_t idI, uint64_t idJ) {
+    if (idI > idJ) {
+        std::swap(i, j);
+        std::swap(idI, idJ);
+    }
+    auto inserted = contacts.emplace(Key{idI, idJ}, Contact{i, j, pass});
+    Contact &contact = inserted.first->second;
+    if (inserted.second) {
+        events.push_back(ContactEvent{idI, idJ, true});
+        return false;
+    }
+    bool persistent = contact.pass != pass;
+    contact = Contact{i, j, pass};
+    return persistent;
+}
+
+void ContactManager::endPass(const std::vector<uint64_t> &ids, const std::vector<uint8_t> &searched) {
+    for (auto it = contacts.begin(); it != contacts.end();) {
+        const Contact &contact = it->second;
+        if (contact.pass == pass) {
+            ++it;
+            continue;
+        }
+        // the indices of the last touch are only valid, if the list did not change since
+        bool valid = contact.i < ids.size() && contact.j < ids.size() && ids[contact.i] == it->first.first &&
+                     ids[contact.j] == it->first.second;
+        if (valid && !searched[contact.i] && !searched[contact.j]) {
+            ++it;
+            continue;
+        }
+        events.push_back(ContactEvent{it->first.first, it->first.second, false});
+        it = contacts.erase(it);
+    }
+}
@@ -0,0 +1,91 @@
+//
+// Created by Trebing, Peter on 2019-10-01.
+//
+
+#ifndef COLLISIONSIM_CONTACTMANAGER_H
+#define COLLISIONSIM_CONTACTMANAGER_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Begin or end of the contact of two objects, given by their ids (first < second)
+ */
+struct ContactEvent {
+    uint64_t first;
+    uint64_t second;
+    bool begin;
+};
+
+/**
+ * Keeps the pairs of touching objects across the collision passes, by the ids of the
+ * objects, so a pass knows which of its overlapping pairs were in contact already and
+ * reports where contacts begin and end.
+ *
+ * A contact ends in the first pass which searched the pairs of one of its objects without
+ * finding it again. Contacts of objects which were not searched, e.g. sleeping molecules or
+ * those left out by the collision budget, are kept as they are.
+ */
+class ContactManager {
+
+public:
+
+    ContactManager() : pass(0) {}
+
+    /**
+     * Starts a pass and clears the events of the last one
+     */
+    void beginPass();
+
+    /**
+     * Records that the candidates i and j with the given ids touch in this pass. Every pair
+     * is to be touched once per pass.
+     * @return true, if the contact began in an earlier pass
+     */
+    bool touch(uint32_t i, uint32_t j, uint64_t idI, uint64_t idJ);
+
+    /**
+     * Ends the contacts which were not touched in this pass, if one of their objects was searched
+     * @param ids of the candidates of this pass, by index
+     * @param searched flag of the candidates whose pairs were searched in this pass, by index
+     */
+    void endPass(const std::vector<uint64_t> &ids, const std::vector<uint8_t> &searched);
+
+    /**
+     * Returns the contacts which began or ended in the last pass, valid until the next one
+     */
+    const std::vector<ContactEvent> &getEvents() const { return events; }
+
+    /**
+     * Returns the number of current contacts
+     */
+    std::size_t getContacts() const { return contacts.size(); }
+
+private:
+
+    struct Key {
+        uint64_t first;
+        uint64_t second;
+
+        bool operator==(const Key &other) const { return first == other.first && second == other.second; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const {
+            return std::hash<uint64_t>()(key.first * 0x9E3779B97F4A7C15ull ^ key.second);
+        }
+    };
+
+    struct Contact {
+        uint32_t i, j;      // indices of the candidates in the pass which touched it last
+        uint64_t pass;
+    };
+
+    uint64_t pass;
+    std::unordered_map<Key, Contact, KeyHash> contacts;
+    std::vector<ContactEvent> events;
+};
+
+#endif //COLLISIONSIM_CONTACTMANAGER_H
@@ -33,6 +33,24 @@ void Controller::HandleInput(bool &running, KeyState &keys) {
                         keys.cool = true;
                         //SDL_Log("SPACE button was pressed!");
                         break;
+                    case SDLK_t:
+                        keys.trace = true;
+                        break;
+                    case SDLK_SPACE:
+                        keys.pause = true;
+                        break;
+                    case SDLK_RIGHT:
+                        keys.forward = true;
+                        break;
+                    case SDLK_LEFT:
+                        keys.backward = true;
+                        break;
+                    case SDLK_UP:
+                        keys.faster = true;
+                        break;
+                    case SDLK_DOWN:
+                        keys.slower = true;
+                        break;
                 }
                 break;
 
@@ -12,6 +12,14 @@ struct KeyState {
     bool minus;
     bool heat;
     bool cool;
+    // replay controls
+    bool pause;
+    bool forward;
+    bool backward;
+    bool faster;
+    bool slower;
+    // write the event trace
+    bool trace;
 };
 
 /**
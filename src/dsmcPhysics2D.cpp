@@ -0,0 +1,241 @@
+//
+// Created by Trebing, Peter on 2019-09-29.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+#include "dsmcPhysics2D.h"
+#include "collision.h"
+#include "parallel.h"
+#include "profiler.h"
+
+namespace {
+
+// Mean width of two squares of sizes s1 and s2 seen from a random direction, divided by
+// s1 + s2. A pair collides if its centres pass within this cross section.
+const double CROSS_SECTION = 4.0 / M_PI;
+
+// Minimum number of molecules per thread of the free flight
+const std::size_t PARALLEL_GRAIN = 8192;
+
+// Minimum number of cells per thread of the collisions
+const std::size_t PARALLEL_CELLS = 256;
+
+}
+
+DsmcPhysics2D::DsmcPhysics2D(Configuration configuration, SimulationObjects &particles) :
+        PhysicsEngine(particles),
+        collisions(0),
+        steps(0),
+        workers(workerCount(configuration.getWorkerThreads())),
+        collisionEnergyChange(0.0),
+        trajectory(nullptr),
+        _cellSize(std::max(configuration.getDsmcCellSize(), 1.0)),
+        _gravity(Vector3(Vector3::GRAVITY) * -configuration.getGravityFactor()),
+        config(configuration) {
+    _columns = std::max<std::size_t>(
+            static_cast<std::size_t>(std::ceil(configuration.getWindowWidth() / _cellSize)), 1);
+    _rows = std::max<std::size_t>(static_cast<std::size_t>(std::ceil(configuration.getWindowHeight() / _cellSize)), 1);
+    _maxCrossSpeed.assign(_columns * _rows, 0.0);
+    _remainder.assign(_columns * _rows, 0.0);
+    for (std::size_t w = 0; w < workers; w++) _engines.emplace_back(static_cast<unsigned>(w + 1));
+}
+
+void DsmcPhysics2D::run() {
+
+    std::chrono::time_point<std::chrono::system_clock> lastUpdate;
+
+    // init stop watch
+    lastUpdate = std::chrono::system_clock::now();
+
+    while (stopRequested() == false) {
+
+        // sleep at every iteration to reduce CPU usage
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
+        long timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count();
+
+        // A step must be shorter than the mean time between collisions, so a long delay
+        // is not simulated at once; the simulation then runs slower than real time.
+        if (timeSinceLastUpdate >= static_cast<long>(config.getPhysicIntervalMs())) {
+            double elapsed = std::chrono::duration<double>(now - lastUpdate).count();
+            advance(std::min(elapsed, config.getTimestepMaxMs() / 1000.0));
+            lastUpdate = now;
+        }
+
+    }
+
+}
+
+void DsmcPhysics2D::advance(double duration) {
+
+    double width = static_cast<double>(config.getWindowWidth());
+    double height = static_cast<double>(config.getWindowHeight());
+
+    static LockSite site("DsmcPhysics2D::advance");
+    _particles.synchronize([this, duration, width, height]() {
+
+        std::size_t n = _particles.size();
+        _objects.resize(n);
+        _cellOf.resize(n);
+
+        TrajectoryWriter *writer = trajectory;
+        TrajectoryFrame *frame = writer != nullptr ? writer->acquire(steps) : nullptr;
+        if (frame != nullptr) writer->prepare(frame, n);
+        std::vector<ObservableSums> sums(workers);
+        std::vector<double> largest(workers, 0.0);
+
+        // free flight under gravity and specular reflection at the walls
+        {
+            ScopedTimer timer(phaseIntegrate);
+            EnergyFactors energyFactors;
+            bool scaling = takeEnergyFactors(energyFactors);
+            _particles.parallelMap(workers, PARALLEL_GRAIN, [this, duration, width, height, writer, frame, scaling,
+                    &energyFactors, &sums, &largest](std::shared_ptr<SimulationObject> &obj, size_t i, size_t worker) {
+
+                if (scaling) energyFactors.apply(*obj);
+                Particle &part = obj->getParticle();
+                double size = static_cast<double>(obj->getSize());
+                double mass = part.getMass();
+                ObservableSums &sum = sums[worker];
+
+                Vector3 position = part.getPosition();
+                Vector3 velocity = part.getVelocity();
+                position.addScaledVector(velocity, duration);
+                position.addScaledVector(_gravity, 0.5 * duration * duration);
+                velocity.addScaledVector(_gravity, duration);
+                if (position.x <= 0.0 || position.x + size > width) {
+                    sum.wallImpulse += 2.0 * mass * std::abs(velocity.x);
+                    velocity.x *= -1.0;
+                    position.x = position.x <= 0.0 ? 0.0 : width - size;
+                }
+                if (position.y <= 0.0 || position.y + size > height) {
+                    sum.wallImpulse += 2.0 * mass * std::abs(velocity.y);
+                    velocity.y *= -1.0;
+                    position.y = position.y <= 0.0 ? 0.0 : height - size;
+                }
+                part.setPosition(position);
+                part.setVelocity(velocity);
+
+                // binned by the centre
+                std::size_t x = std::min(static_cast<std::size_t>((position.x + 0.5 * size) / _cellSize), _columns - 1);
+                std::size_t y = std::min(static_cast<std::size_t>((position.y + 0.5 * size) / _cellSize), _rows - 1);
+                _objects[i] = obj.get();
+                _cellOf[i] = static_cast<uint32_t>(y * _columns + x);
+                largest[worker] = std::max(largest[worker], size);
+
+                Species species = obj->getSpecies();
+                ++sum.count[species];
+                ++sum.integrated;
+                sum.kineticEnergy[species] += 0.5 * mass * velocity.squareMagnitude();
+                sum.momentumX += mass * velocity.x;
+                sum.momentumY += mass * velocity.y;
+                sum.maxSpeedSquared = std::max(sum.maxSpeedSquared, velocity.squareMagnitude());
+                sum.minSize = std::min(sum.minSize, obj->getSize());
+                if (frame != nullptr) writer->record(frame, i, obj->getId(), position, velocity, species);
+            }, &site);
+        }
+        for (std::size_t w = 1; w < workers; w++) sums[0].add(sums[w]);
+        if (frame != nullptr) writer->submit(frame, n);
+
+        {
+            ScopedTimer timer(phaseBroadphase);
+            bin();
+        }
+
+        // a cell starts with the largest pair moving head on at the highest speed
+        double size = *std::max_element(largest.begin(), largest.end());
+        double initialCrossSpeed = CROSS_SECTION * 2.0 * size * 2.0 * std::sqrt(sums[0].maxSpeedSquared);
+        std::size_t collisionCount;
+        {
+            ScopedTimer timer(phaseResolve);
+            collisionCount = collide(duration, initialCrossSpeed);
+        }
+        ++steps;
+
+        std::lock_guard<std::mutex> uLock(_mutex);
+        observables.update(sums[0], duration);
+        observables.collisionEnergyChange = collisionEnergyChange;
+        collisions += collisionCount;
+    }, &site);
+}
+
+void DsmcPhysics2D::bin() {
+    std::size_t cells = _columns * _rows;
+    _cellStart.assign(cells + 1, 0);
+    for (uint32_t cell: _cellOf) ++_cellStart[cell + 1];
+    std::partial_sum(_cellStart.begin(), _cellStart.end(), _cellStart.begin());
+    _order.resize(_cellOf.size());
+    std::vector<uint32_t> next(_cellStart.begin(), _cellStart.end() - 1);
+    for (uint32_t i = 0; i < _cellOf.size(); i++) _order[next[_cellOf[i]]++] = i;
+}
+
+std::size_t DsmcPhysics2D::collide(double duration, double initialCrossSpeed) {
+
+    double width = static_cast<double>(config.getWindowWidth());
+    double height = static_cast<double>(config.getWindowHeight());
+    std::size_t cells = _columns * _rows;
+    std::size_t cellWorkers = std::max<std::size_t>(std::min(workers, cells / PARALLEL_CELLS), 1);
+    std::vector<std::size_t> counts(cellWorkers, 0);
+    std::vector<double> energyChanges(cellWorkers, 0.0);
+
+    // the cells are independent, every worker samples its block with its own generator
+    parallelFor(cells, cellWorkers, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        std::mt19937 &engine = _engines[worker];
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::uniform_real_distribution<double> angle(0.0, 2.0 * M_PI);
+        for (std::size_t c = begin; c < end; c++) {
+            uint32_t first = _cellStart[c];
+            uint32_t count = _cellStart[c + 1] - first;
+            if (count < 2) continue;
+
+            // the outer cells may be cut by the walls
+            double cellWidth = std::min(_cellSize, width - static_cast<double>(c % _columns) * _cellSize);
+            double cellHeight = std::min(_cellSize, height - static_cast<double>(c / _columns) * _cellSize);
+            double area = std::max(cellWidth * cellHeight, 1.0);
+
+            // no time counter: candidates N (N - 1) / 2 * (sigma c)max * dt / A, of which a
+            // pair is accepted with the probability sigma c / (sigma c)max
+            double &maxCrossSpeed = _maxCrossSpeed[c];
+            if (maxCrossSpeed <= 0.0) maxCrossSpeed = initialCrossSpeed;
+            double expected = 0.5 * count * (count - 1) * maxCrossSpeed * duration / area + _remainder[c];
+            std::size_t candidates = static_cast<std::size_t>(expected);
+            _remainder[c] = expected - static_cast<double>(candidates);
+
+            std::uniform_int_distribution<uint32_t> pick(0, count - 1), pickOther(0, count - 2);
+            for (std::size_t k = 0; k < candidates; k++) {
+                uint32_t a = pick(engine);
+                uint32_t b = pickOther(engine);
+                if (b >= a) ++b;
+                SimulationObject *obj1 = _objects[_order[first + a]];
+                SimulationObject *obj2 = _objects[_order[first + b]];
+                Particle &part1 = obj1->getParticle();
+                Particle &part2 = obj2->getParticle();
+                Vector3 v1 = part1.getVelocity();
+                Vector3 v2 = part2.getVelocity();
+
+                double crossSpeed = CROSS_SECTION * static_cast<double>(obj1->getSize() + obj2->getSize()) *
+                                    std::sqrt((v2 - v1).squareMagnitude());
+                maxCrossSpeed = std::max(maxCrossSpeed, crossSpeed);
+                if (uniform(engine) * maxCrossSpeed >= crossSpeed) continue;
+
+                // hard squares hit from a random direction
+                double phi = angle(engine);
+                Vector3 v1Next = v1, v2Next = v2;
+                double m1 = part1.getMass(), m2 = part2.getMass();
+                if (!elasticCollision(v1Next, m1, v2Next, m2, Vector3(std::cos(phi), std::sin(phi), 0.0))) continue;
+                part1.setVelocity(v1Next);
+                part2.setVelocity(v2Next);
+                ++counts[worker];
+                energyChanges[worker] += 0.5 * m1 * (v1Next.squareMagnitude() - v1.squareMagnitude()) +
+                                         0.5 * m2 * (v2Next.squareMagnitude() - v2.squareMagnitude());
+            }
+        }
+    });
+
+    for (double change: energyChanges) collisionEnergyChange += change;
+    return std::accumulate(counts.begin(), counts.end(), std::size_t(0));
+}
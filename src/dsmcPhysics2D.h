@@ -0,0 +1,100 @@
+//
+// Created by Trebing, Peter on 2019-09-29.
+//
+
+#ifndef COLLISIONSIM_DSMCPHYSICS2D_H
+#define COLLISIONSIM_DSMCPHYSICS2D_H
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "physicsEngine.h"
+
+/**
+ * Direct Simulation Monte Carlo (Bird): the molecules fly freely for a time step and are
+ * then binned into the cells of a grid. Within a cell, collision partners are sampled at
+ * random, as many as the kinetic theory of the cell expects (no time counter scheme), so
+ * the statistics of the gas are right while the individual pairs are not. Molecules may
+ * pass through each other. The cost is linear in the number of molecules and the cells
+ * collide in parallel.
+ */
+class DsmcPhysics2D : public PhysicsEngine {
+
+public:
+
+    DsmcPhysics2D(Configuration configuration, SimulationObjects &particles);
+
+    /**
+     * Moves, bins and collides the molecules every physics interval.
+     * This method is intended to be used in its own thread
+     */
+    void run() override;
+
+    /**
+     * Returns at once, the collisions are sampled by the run thread
+     */
+    void collider() override {}
+
+    /**
+     * Moves all molecules by the duration and samples their collisions
+     */
+    void step(double duration) override { advance(duration); }
+
+    void setTrajectoryWriter(TrajectoryWriter *writer) override { trajectory = writer; }
+
+    std::size_t getCollisionsSincelastCall() override {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        std::size_t result = collisions;
+        collisions = 0;
+        return result;
+    }
+
+    Observables getObservables() override {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        return observables;
+    }
+
+    std::size_t getSteps() override { return steps.load(); }
+
+private:
+
+    void advance(double duration);
+
+    /**
+     * Sorts the molecules by their cell (counting sort)
+     */
+    void bin();
+
+    /**
+     * Samples the collisions of all cells
+     * @param initialCrossSpeed estimate of the largest cross section times relative speed,
+     * for the cells which have none yet
+     * @return number of collisions
+     */
+    std::size_t collide(double duration, double initialCrossSpeed);
+
+    std::mutex _mutex;
+    std::size_t collisions;
+    std::atomic<std::size_t> steps;
+    std::size_t workers;
+    Observables observables;
+    double collisionEnergyChange;
+    TrajectoryWriter *trajectory;
+
+    // state of the run thread, kept to reuse the allocated memory
+    std::vector<SimulationObject *> _objects;
+    std::vector<uint32_t> _cellOf;          // cell of each molecule
+    std::vector<uint32_t> _cellStart;       // first entry of each cell in _order, one more at the end
+    std::vector<uint32_t> _order;           // molecules sorted by cell
+    std::vector<double> _maxCrossSpeed;     // largest cross section times relative speed seen per cell
+    std::vector<double> _remainder;         // fraction of a candidate pair carried to the next step
+    std::vector<std::mt19937> _engines;     // one per worker
+    std::size_t _columns, _rows;
+    double _cellSize;
+    Vector3 _gravity;
+
+    Configuration config;
+};
+
+#endif //COLLISIONSIM_DSMCPHYSICS2D_H
@@ -0,0 +1,399 @@
+//
+// Created by Trebing, Peter on 2019-09-28.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include "eventDrivenPhysics2D.h"
+#include "collision.h"
+#include "profiler.h"
+
+namespace {
+
+const double NEVER = std::numeric_limits<double>::infinity();
+
+// Events per molecule and tick, beyond the tick gives up. Elastic walls and collisions
+// cannot pile up events, but rounding may, e.g. for a molecule resting on the floor.
+const std::size_t MAX_EVENTS_PER_MOLECULE = 1000;
+
+/**
+ * Earliest time t >= 0 at which p + v t + a t^2 / 2 crosses the level in the given
+ * direction (+1 upwards, -1 downwards)
+ * @return infinity, if it never does
+ */
+double crossingTime(double p, double v, double a, double level, double direction) {
+
+    double c = p - level;
+    // already beyond the level by rounding, and moving on
+    if (c * direction >= 0.0 && v * direction > 0.0) return 0.0;
+
+    double roots[2] = {NEVER, NEVER};
+    if (a == 0.0) {
+        if (v != 0.0) roots[0] = -c / v;
+    } else {
+        double discriminant = v * v - 2.0 * a * c;
+        if (discriminant < 0.0) return NEVER;
+        // numerically stable roots of a/2 t^2 + v t + c
+        double q = -0.5 * (v + std::copysign(std::sqrt(discriminant), v));
+        roots[0] = q / (0.5 * a);
+        roots[1] = q != 0.0 ? c / q : roots[0];
+        if (roots[0] > roots[1]) std::swap(roots[0], roots[1]);
+    }
+    for (double t: roots) {
+        if (t >= 0.0 && t < NEVER && (v + a * t) * direction > 0.0) return t;
+    }
+    return NEVER;
+}
+
+}
+
+EventDrivenPhysics2D::EventDrivenPhysics2D(Configuration configuration, SimulationObjects &particles) :
+        PhysicsEngine(particles),
+        collisions(0),
+        steps(0),
+        events(0),
+        collisionEnergyChange(0.0),
+        trajectory(nullptr),
+        _columns(1),
+        _rows(1),
+        _cellSize(1.0),
+        _time(0.0),
+        _wallImpulse(0.0),
+        _gravity(Vector3(Vector3::GRAVITY) * -configuration.getGravityFactor()),
+        _rebuild(true),
+        config(configuration) {
+}
+
+void EventDrivenPhysics2D::run() {
+
+    std::chrono::time_point<std::chrono::system_clock> lastUpdate;
+
+    // init stop watch
+    lastUpdate = std::chrono::system_clock::now();
+
+    while (stopRequested() == false) {
+
+        // sleep at every iteration to reduce CPU usage
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
+        long timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count();
+
+        if (timeSinceLastUpdate >= static_cast<long>(config.getPhysicIntervalMs())) {
+            advance(std::chrono::duration<double>(now - lastUpdate).count());
+            lastUpdate = now;
+        }
+
+    }
+
+}
+
+void EventDrivenPhysics2D::advance(double duration) {
+
+    static LockSite site("EventDrivenPhysics2D::advance");
+    _particles.synchronize([this, duration]() {
+
+        // Molecules added or removed by the user. Heated or cooled ones change their
+        // flights, all are predicted again from the objects.
+        EnergyFactors energyFactors;
+        bool changed = takeEnergyFactors(energyFactors);
+        if (changed) {
+            _particles.map([&energyFactors](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+                energyFactors.apply(*obj);
+                return false;
+            });
+        }
+        changed = _rebuild.exchange(false) || changed || _particles.size() != _objects.size();
+        if (!changed) {
+            _particles.map([this, &changed](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+                changed = obj != _objects[i];
+                return changed;
+            });
+        }
+        if (changed) rebuild();
+
+        ScopedTimer timer(phaseIntegrate);
+        double end = _time + duration;
+        std::size_t limit = MAX_EVENTS_PER_MOLECULE * _states.size() + 1;
+        std::size_t processed = 0;
+        std::size_t collisionCount = 0;
+        while (!_events.empty() && _events.top().time <= end) {
+            Event event = _events.top();
+            _events.pop();
+            State &first = _states[event.i];
+            if (event.versionI != first.version) continue;
+            if (event.kind == eventPair && event.versionJ != _states[event.j].version) continue;
+
+            if (++processed > limit) {
+                static std::once_flag warned;
+                std::call_once(warned, []() {
+                    std::cerr << "Too many events in one tick, predicting from scratch.\n";
+                });
+                _rebuild = true;
+                break;
+            }
+
+            moveTo(event.i, event.time);
+            if (event.kind == eventPair) {
+                // elastic collision along the axis of the contact
+                State &second = _states[event.j];
+                moveTo(event.j, event.time);
+                Vector3 v1 = first.velocity, v2 = second.velocity;
+                Vector3 normal = event.side == 0 ? Vector3(1.0, 0.0, 0.0) : Vector3(0.0, 1.0, 0.0);
+                if (elasticCollision(first.velocity, first.mass, second.velocity, second.mass, normal)) {
+                    collisionEnergyChange +=
+                            0.5 * first.mass * (first.velocity.squareMagnitude() - v1.squareMagnitude()) +
+                            0.5 * second.mass * (second.velocity.squareMagnitude() - v2.squareMagnitude());
+                    ++collisionCount;
+                }
+                ++first.version;
+                ++second.version;
+                predict(event.i);
+                predict(event.j);
+            } else if (event.kind == eventWall) {
+                // reflect and place exactly at the wall
+                double width = static_cast<double>(config.getWindowWidth());
+                double height = static_cast<double>(config.getWindowHeight());
+                if (event.side < 2) {
+                    _wallImpulse += 2.0 * first.mass * std::abs(first.velocity.x);
+                    first.velocity.x *= -1.0;
+                    first.position.x = event.side == 0 ? 0.0 : width - first.size;
+                } else {
+                    _wallImpulse += 2.0 * first.mass * std::abs(first.velocity.y);
+                    first.velocity.y *= -1.0;
+                    first.position.y = event.side == 2 ? 0.0 : height - first.size;
+                }
+                ++first.version;
+                predict(event.i);
+            } else {
+                // the flight does not change, only the neighbours
+                std::vector<uint32_t> &from = cell(first.cellX, first.cellY);
+                from.erase(std::find(from.begin(), from.end(), event.i));
+                if (event.side == 0) --first.cellX;
+                else if (event.side == 1) ++first.cellX;
+                else if (event.side == 2) --first.cellY;
+                else ++first.cellY;
+                cell(first.cellX, first.cellY).push_back(event.i);
+                predictCell(event.i);
+                predictNeighbours(event.i);
+            }
+        }
+        events += std::min(processed, limit);
+        _time = end;
+
+        // publish the state at the end of the tick
+        TrajectoryWriter *writer = trajectory;
+        TrajectoryFrame *frame = writer != nullptr ? writer->acquire(steps) : nullptr;
+        if (frame != nullptr) writer->prepare(frame, _states.size());
+        ObservableSums sums;
+        sums.wallImpulse = _wallImpulse;
+        _wallImpulse = 0.0;
+        _particles.map([this, end, writer, frame, &sums](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+            const State &state = _states[i];
+            Particle &part = obj->getParticle();
+            Vector3 velocity = velocityAt(state, end);
+            part.setPosition(positionAt(state, end));
+            part.setVelocity(velocity);
+
+            Species species = obj->getSpecies();
+            ++sums.count[species];
+            ++sums.integrated;
+            sums.kineticEnergy[species] += 0.5 * state.mass * velocity.squareMagnitude();
+            sums.momentumX += state.mass * velocity.x;
+            sums.momentumY += state.mass * velocity.y;
+            sums.maxSpeedSquared = std::max(sums.maxSpeedSquared, velocity.squareMagnitude());
+            sums.minSize = std::min(sums.minSize, obj->getSize());
+            if (frame != nullptr) writer->record(frame, i, obj->getId(), part.getPosition(), velocity, species);
+            return false;
+        });
+        if (frame != nullptr) writer->submit(frame, _states.size());
+        ++steps;
+
+        std::lock_guard<std::mutex> uLock(_mutex);
+        observables.update(sums, duration);
+        observables.collisionEnergyChange = collisionEnergyChange;
+        collisions += collisionCount;
+    }, &site);
+}
+
+void EventDrivenPhysics2D::rebuild() {
+
+    double width = static_cast<double>(config.getWindowWidth());
+    double height = static_cast<double>(config.getWindowHeight());
+
+    _objects.clear();
+    _states.clear();
+    double largest = 1.0;
+    _particles.map([this, width, height, &largest](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        Particle &part = obj->getParticle();
+        State state;
+        state.size = static_cast<double>(obj->getSize());
+        state.mass = part.getMass();
+        // inside the walls, as the time stepped physics may leave them slightly behind
+        Vector3 position = part.getPosition();
+        position.x = std::max(0.0, std::min(position.x, width - state.size));
+        position.y = std::max(0.0, std::min(position.y, height - state.size));
+        state.position = position;
+        state.velocity = part.getVelocity();
+        state.time = _time;
+        state.nextCrossing = NEVER;
+        state.version = 0;
+        largest = std::max(largest, state.size);
+        _objects.push_back(obj);
+        _states.push_back(state);
+        return false;
+    });
+
+    // a molecule is not larger than a cell, so touching ones are in neighbouring cells
+    _cellSize = largest;
+    _columns = std::max<std::size_t>(static_cast<std::size_t>(std::ceil(width / _cellSize)), 1);
+    _rows = std::max<std::size_t>(static_cast<std::size_t>(std::ceil(height / _cellSize)), 1);
+    _cells.assign(_columns * _rows, std::vector<uint32_t>());
+    for (uint32_t i = 0; i < _states.size(); i++) {
+        State &state = _states[i];
+        state.cellX = std::min(static_cast<std::size_t>(state.position.x / _cellSize), _columns - 1);
+        state.cellY = std::min(static_cast<std::size_t>(state.position.y / _cellSize), _rows - 1);
+        cell(state.cellX, state.cellY).push_back(i);
+    }
+
+    _events = std::priority_queue<Event, std::vector<Event>, std::greater<Event>>();
+    for (uint32_t i = 0; i < _states.size(); i++) {
+        predictCell(i);
+        predictWall(i);
+    }
+    // every pair once, both crossings are known
+    for (uint32_t i = 0; i < _states.size(); i++) {
+        const State &state = _states[i];
+        for (std::size_t y = state.cellY > 0 ? state.cellY - 1 : 0; y <= std::min(state.cellY + 1, _rows - 1); y++) {
+            for (std::size_t x = state.cellX > 0 ? state.cellX - 1 : 0;
+                 x <= std::min(state.cellX + 1, _columns - 1); x++) {
+                for (uint32_t j: cell(x, y)) {
+                    if (j > i) predictPair(i, j);
+                }
+            }
+        }
+    }
+}
+
+Vector3 EventDrivenPhysics2D::positionAt(const State &state, double time) const {
+    double dt = time - state.time;
+    Vector3 position = state.position;
+    position.addScaledVector(state.velocity, dt);
+    position.addScaledVector(_gravity, 0.5 * dt * dt);
+    return position;
+}
+
+Vector3 EventDrivenPhysics2D::velocityAt(const State &state, double time) const {
+    Vector3 velocity = state.velocity;
+    velocity.addScaledVector(_gravity, time - state.time);
+    return velocity;
+}
+
+void EventDrivenPhysics2D::moveTo(uint32_t i, double time) {
+    State &state = _states[i];
+    state.position = positionAt(state, time);
+    state.velocity = velocityAt(state, time);
+    state.time = time;
+}
+
+void EventDrivenPhysics2D::predict(uint32_t i) {
+    predictCell(i);
+    predictWall(i);
+    predictNeighbours(i);
+}
+
+void EventDrivenPhysics2D::predictCell(uint32_t i) {
+
+    State &state = _states[i];
+    double p[2] = {state.position.x, state.position.y};
+    double v[2] = {state.velocity.x, state.velocity.y};
+    double a[2] = {_gravity.x, _gravity.y};
+    std::size_t c[2] = {state.cellX, state.cellY};
+    std::size_t cells[2] = {_columns, _rows};
+
+    double earliest = NEVER;
+    uint8_t side = 0;
+    for (int axis = 0; axis < 2; axis++) {
+        // the outer cells have no neighbour beyond, the walls come first
+        if (c[axis] > 0) {
+            double t = crossingTime(p[axis], v[axis], a[axis], c[axis] * _cellSize, -1.0);
+            if (t < earliest) {
+                earliest = t;
+                side = static_cast<uint8_t>(2 * axis);
+            }
+        }
+        if (c[axis] + 1 < cells[axis]) {
+            double t = crossingTime(p[axis], v[axis], a[axis], (c[axis] + 1) * _cellSize, 1.0);
+            if (t < earliest) {
+                earliest = t;
+                side = static_cast<uint8_t>(2 * axis + 1);
+            }
+        }
+    }
+    state.nextCrossing = state.time + earliest;
+    if (earliest < NEVER) _events.push(Event{state.nextCrossing, i, i, state.version, state.version, eventCell, side});
+}
+
+void EventDrivenPhysics2D::predictWall(uint32_t i) {
+
+    State &state = _states[i];
+    double width = static_cast<double>(config.getWindowWidth());
+    double height = static_cast<double>(config.getWindowHeight());
+    double t[4] = {
+            crossingTime(state.position.x, state.velocity.x, _gravity.x, 0.0, -1.0),
+            crossingTime(state.position.x, state.velocity.x, _gravity.x, width - state.size, 1.0),
+            crossingTime(state.position.y, state.velocity.y, _gravity.y, 0.0, -1.0),
+            crossingTime(state.position.y, state.velocity.y, _gravity.y, height - state.size, 1.0)
+    };
+    uint8_t side = static_cast<uint8_t>(std::min_element(t, t + 4) - t);
+    if (t[side] < NEVER) _events.push(Event{state.time + t[side], i, i, state.version, state.version, eventWall, side});
+}
+
+void EventDrivenPhysics2D::predictNeighbours(uint32_t i) {
+    const State &state = _states[i];
+    for (std::size_t y = state.cellY > 0 ? state.cellY - 1 : 0; y <= std::min(state.cellY + 1, _rows - 1); y++) {
+        for (std::size_t x = state.cellX > 0 ? state.cellX - 1 : 0; x <= std::min(state.cellX + 1, _columns - 1); x++) {
+            for (uint32_t j: cell(x, y)) {
+                if (j != i) predictPair(i, j);
+            }
+        }
+    }
+}
+
+void EventDrivenPhysics2D::predictPair(uint32_t i, uint32_t j) {
+
+    // Both fall alike, so they approach linearly. Molecule i is at the current time.
+    const State &first = _states[i];
+    const State &second = _states[j];
+    double now = first.time;
+    Vector3 d = positionAt(second, now) - first.position;
+    Vector3 w = velocityAt(second, now) - first.velocity;
+
+    // the boxes overlap while -size2 < d + w t < size1 on both axes
+    double dist[2] = {d.x, d.y};
+    double rel[2] = {w.x, w.y};
+    double enter = -NEVER, exit = NEVER;
+    uint8_t axis = 0;
+    for (uint8_t a = 0; a < 2; a++) {
+        if (rel[a] == 0.0) {
+            if (dist[a] <= -second.size || dist[a] >= first.size) return;
+            continue;
+        }
+        double t1 = (-second.size - dist[a]) / rel[a];
+        double t2 = (first.size - dist[a]) / rel[a];
+        if (std::min(t1, t2) > enter) {
+            enter = std::min(t1, t2);
+            axis = a;
+        }
+        exit = std::min(exit, std::max(t1, t2));
+    }
+
+    // Overlapping molecules, e.g. just after their collision, separate without an event.
+    // Beyond the next cell crossing of either, the prediction is repeated anyway.
+    if (enter < 0.0 || enter >= exit) return;
+    double time = now + enter;
+    if (time > std::min(first.nextCrossing, second.nextCrossing)) return;
+    _events.push(Event{time, i, j, first.version, second.version, eventPair, axis});
+}
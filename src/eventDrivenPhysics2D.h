@@ -0,0 +1,160 @@
+//
+// Created by Trebing, Peter on 2019-09-28.
+//
+
+#ifndef COLLISIONSIM_EVENTDRIVENPHYSICS2D_H
+#define COLLISIONSIM_EVENTDRIVENPHYSICS2D_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include "physicsEngine.h"
+
+/**
+ * Event driven physics: instead of moving all molecules by small time steps, it predicts
+ * for every molecule when it hits a wall or another molecule next and jumps from event to
+ * event. Between two events a molecule flies on a parabola under gravity, without drag.
+ * Every physics tick processes the events up to the current time and publishes the
+ * positions at that time, so rendering, trajectories and observables sample the exact
+ * state at the tick.
+ *
+ * Pairs are only predicted for molecules in neighbouring cells of a grid, as in the
+ * collider of Rapaport: crossing a cell boundary is an event as well, after which the
+ * molecule predicts its pairs with its new neighbours.
+ */
+class EventDrivenPhysics2D : public PhysicsEngine {
+
+public:
+
+    EventDrivenPhysics2D(Configuration configuration, SimulationObjects &particles);
+
+    /**
+     * Processes the events up to the current time, every physics interval.
+     * This method is intended to be used in its own thread
+     */
+    void run() override;
+
+    /**
+     * Returns at once, the collisions are events of the run thread
+     */
+    void collider() override {}
+
+    /**
+     * Processes all events of the given duration and publishes the state at its end
+     */
+    void step(double duration) override { advance(duration); }
+
+    void setTrajectoryWriter(TrajectoryWriter *writer) override { trajectory = writer; }
+
+    std::size_t getCollisionsSincelastCall() override {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        std::size_t result = collisions;
+        collisions = 0;
+        return result;
+    }
+
+    Observables getObservables() override {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        return observables;
+    }
+
+    std::size_t getSteps() override { return steps.load(); }
+
+    /**
+     * Returns the number of processed events since the start, stale predictions not included
+     */
+    std::size_t getEvents() const { return events.load(); }
+
+private:
+
+    enum EventKind : uint8_t {
+        eventPair,      // two molecules touch, side is the axis of the contact
+        eventWall,      // side: 0 left, 1 right, 2 top, 3 bottom wall
+        eventCell       // side: 0 -x, 1 +x, 2 -y, 3 +y neighbour cell
+    };
+
+    struct Event {
+        double time;
+        uint32_t i, j;
+        uint32_t versionI, versionJ;
+        EventKind kind;
+        uint8_t side;
+
+        bool operator>(const Event &other) const { return time > other.time; }
+    };
+
+    // Flight of a molecule since its last event. The version counts the changes of the
+    // velocity, events predicted for an older version are stale.
+    struct State {
+        Vector3 position;
+        Vector3 velocity;
+        double time;
+        double mass;
+        double size;
+        double nextCrossing;    // time of leaving the cell, pairs are predicted up to it
+        uint32_t version;
+        std::size_t cellX, cellY;
+    };
+
+    void advance(double duration);
+
+    /**
+     * Takes over the objects, if they were added, removed or changed from outside, and
+     * predicts all events from scratch
+     */
+    void rebuild();
+
+    Vector3 positionAt(const State &state, double time) const;
+
+    Vector3 velocityAt(const State &state, double time) const;
+
+    /**
+     * Moves a molecule along its flight to the given time
+     */
+    void moveTo(uint32_t i, double time);
+
+    /**
+     * Predicts all events of a molecule whose velocity changed
+     */
+    void predict(uint32_t i);
+
+    void predictCell(uint32_t i);
+
+    void predictWall(uint32_t i);
+
+    /**
+     * Predicts the contacts of a molecule with the molecules of its own and the eight
+     * neighbouring cells
+     */
+    void predictNeighbours(uint32_t i);
+
+    void predictPair(uint32_t i, uint32_t j);
+
+    std::vector<uint32_t> &cell(std::size_t x, std::size_t y) { return _cells[y * _columns + x]; }
+
+    std::mutex _mutex;
+    std::size_t collisions;
+    std::atomic<std::size_t> steps;
+    std::atomic<std::size_t> events;
+    Observables observables;
+    double collisionEnergyChange;
+    TrajectoryWriter *trajectory;
+
+    // state of the run thread, valid while the list of objects is unchanged
+    std::vector<std::shared_ptr<SimulationObject>> _objects;
+    std::vector<State> _states;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+    std::vector<std::vector<uint32_t>> _cells;
+    std::size_t _columns, _rows;
+    double _cellSize;
+    double _time;                   // simulated time of the last tick
+    double _wallImpulse;            // of the events of the current tick
+    Vector3 _gravity;               // the same for all molecules, so pairs approach linearly
+    std::atomic<bool> _rebuild;     // predict from scratch at the next tick
+
+    Configuration config;
+};
+
+#endif //COLLISIONSIM_EVENTDRIVENPHYSICS2D_H
@@ -0,0 +1,174 @@
+//
+// Created by Trebing, Peter on 2019-09-30.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "interactions.h"
+#include "parallel.h"
+
+namespace {
+
+// Closer than this multiple of sigma the force stays constant
+const double LJ_MIN_DISTANCE = 0.8;
+
+// Minimum number of molecules per thread of the force computation
+const std::size_t PARALLEL_GRAIN = 4096;
+
+// V(r) = 4 epsilon ((sigma/r)^12 - (sigma/r)^6)
+double potential(double distance, double sigma, double epsilon) {
+    double s6 = std::pow(sigma / distance, 6.0);
+    return 4.0 * epsilon * (s6 * s6 - s6);
+}
+
+}
+
+bool NeighbourList::update(const std::vector<std::shared_ptr<SimulationObject>> &objects,
+                           const std::vector<Vector3> &centres, double radius, double skin) {
+
+    bool changed = objects.size() != _objects.size() || radius != _radius || skin != _skin;
+    for (std::size_t i = 0; i < objects.size() && !changed; i++) changed = objects[i] != _objects[i];
+    if (!changed) {
+        // a pair can only have come within the radius, if one of them moved half the skin
+        double limit = 0.25 * skin * skin;
+        for (std::size_t i = 0; i < centres.size() && !changed; i++) {
+            changed = (centres[i] - _reference[i]).squareMagnitude() > limit;
+        }
+    }
+    if (!changed) return false;
+
+    _objects = objects;
+    _reference = centres;
+    _radius = radius;
+    _skin = skin;
+    build(centres, radius + skin);
+    ++builds;
+    return true;
+}
+
+void NeighbourList::build(const std::vector<Vector3> &centres, double reach) {
+
+    std::size_t n = centres.size();
+    _offsets.assign(n + 1, 0);
+    _neighbours.clear();
+    if (n == 0) return;
+
+    // counting sort into cells of the reach, so all neighbours are in the 3x3 cells around
+    double minX = centres[0].x, minY = centres[0].y, maxX = minX, maxY = minY;
+    for (const Vector3 &c: centres) {
+        minX = std::min(minX, c.x);
+        minY = std::min(minY, c.y);
+        maxX = std::max(maxX, c.x);
+        maxY = std::max(maxY, c.y);
+    }
+    std::size_t columns = static_cast<std::size_t>((maxX - minX) / reach) + 1;
+    std::size_t rows = static_cast<std::size_t>((maxY - minY) / reach) + 1;
+    _cellOf.resize(n);
+    _cellStart.assign(columns * rows + 1, 0);
+    for (std::size_t i = 0; i < n; i++) {
+        std::size_t x = static_cast<std::size_t>((centres[i].x - minX) / reach);
+        std::size_t y = static_cast<std::size_t>((centres[i].y - minY) / reach);
+        _cellOf[i] = static_cast<uint32_t>(y * columns + x);
+        ++_cellStart[_cellOf[i] + 1];
+    }
+    std::partial_sum(_cellStart.begin(), _cellStart.end(), _cellStart.begin());
+    _order.resize(n);
+    std::vector<uint32_t> next(_cellStart.begin(), _cellStart.end() - 1);
+    for (uint32_t i = 0; i < n; i++) _order[next[_cellOf[i]]++] = i;
+
+    double reachSquared = reach * reach;
+    for (std::size_t i = 0; i < n; i++) {
+        std::size_t x = _cellOf[i] % columns, y = _cellOf[i] / columns;
+        for (std::size_t cy = y > 0 ? y - 1 : 0; cy <= std::min(y + 1, rows - 1); cy++) {
+            for (std::size_t cx = x > 0 ? x - 1 : 0; cx <= std::min(x + 1, columns - 1); cx++) {
+                std::size_t cell = cy * columns + cx;
+                for (uint32_t k = _cellStart[cell]; k < _cellStart[cell + 1]; k++) {
+                    uint32_t j = _order[k];
+                    if (j != i && (centres[j] - centres[i]).squareMagnitude() <= reachSquared) {
+                        _neighbours.push_back(j);
+                    }
+                }
+            }
+        }
+        _offsets[i + 1] = static_cast<uint32_t>(_neighbours.size());
+    }
+}
+
+void LennardJones::compute(SimulationObjects &objects, std::size_t workers, const std::vector<uint32_t> *due) {
+
+    // snapshot of the centres, the forces are computed without the lock
+    _objects.clear();
+    _centres.clear();
+    _sizes.clear();
+    double largest = 0.0;
+    static LockSite site("LennardJones::compute");
+    objects.map([this, &largest](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        double size = static_cast<double>(obj->getSize());
+        Vector3 centre = obj->getParticle().getPosition();
+        centre.x += 0.5 * size;
+        centre.y += 0.5 * size;
+        _objects.push_back(obj);
+        _centres.push_back(centre);
+        _sizes.push_back(size);
+        largest = std::max(largest, size);
+        return false;
+    }, &site);
+
+    _list.update(_objects, _centres, cutoff * largest, skin);
+
+    // every molecule sums up its own force from its symmetric list
+    std::size_t n = _centres.size();
+    if (_forces.size() != n) _forces.assign(n, Vector3());
+    std::size_t count = due != nullptr ? due->size() : n;
+    workers = std::max<std::size_t>(std::min(workers, count / PARALLEL_GRAIN), 1);
+    parallelFor(count, workers, [this, due](std::size_t begin, std::size_t end, std::size_t worker) {
+        for (std::size_t k = begin; k < end; k++) {
+            std::size_t i = due != nullptr ? (*due)[k] : k;
+            _forces[i] = force(i);
+        }
+    });
+}
+
+Vector3 LennardJones::force(std::size_t i) const {
+    Vector3 force;
+    for (const uint32_t *j = _list.begin(i); j != _list.end(i); j++) {
+        Vector3 d = _centres[*j] - _centres[i];
+        double distanceSquared = d.squareMagnitude();
+        double sigma = 0.5 * (_sizes[i] + _sizes[*j]);
+        double sigmaSquared = sigma * sigma;
+        if (distanceSquared >= cutoff * cutoff * sigmaSquared || distanceSquared == 0.0) continue;
+
+        // F(r) = 24 epsilon / r (2 (sigma/r)^12 - (sigma/r)^6), pushing i away from j
+        double limited = std::max(distanceSquared, LJ_MIN_DISTANCE * LJ_MIN_DISTANCE * sigmaSquared);
+        double s6 = sigmaSquared / limited;
+        s6 = s6 * s6 * s6;
+        double magnitude = 24.0 * epsilon * (2.0 * s6 * s6 - s6) / limited;
+        force.addScaledVector(d, -magnitude * std::sqrt(limited / distanceSquared));
+    }
+    return force;
+}
+
+double LennardJones::getPotentialEnergy() const {
+    double energy = 0.0;
+    for (std::size_t i = 0; i < _centres.size(); i++) {
+        for (const uint32_t *j = _list.begin(i); j != _list.end(i); j++) {
+            if (*j < i) continue;
+            double distance = std::sqrt((_centres[*j] - _centres[i]).squareMagnitude());
+            double sigma = 0.5 * (_sizes[i] + _sizes[*j]);
+            if (distance >= cutoff * sigma) continue;
+
+            // below the minimum distance the force is constant, so the potential is linear
+            double minimum = LJ_MIN_DISTANCE * sigma;
+            double limited = std::max(distance, minimum);
+            double v = potential(limited, sigma, epsilon);
+            if (distance < minimum) {
+                double s6 = std::pow(sigma / minimum, 6.0);
+                v += 24.0 * epsilon * (2.0 * s6 * s6 - s6) / minimum * (minimum - distance);
+            }
+            // shifted to zero at the cutoff, where the force ends
+            energy += v - potential(cutoff * sigma, sigma, epsilon);
+        }
+    }
+    return energy;
+}
@@ -0,0 +1,126 @@
+//
+// Created by Trebing, Peter on 2019-09-30.
+//
+
+#ifndef COLLISIONSIM_INTERACTIONS_H
+#define COLLISIONSIM_INTERACTIONS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "mathtools.h"
+#include "simulationObject.h"
+
+/**
+ * Verlet neighbour lists: for every molecule, all molecules within the interaction radius
+ * plus a skin. As long as no molecule moved further than half the skin since the lists were
+ * built, no pair can have come within the radius unlisted, so the lists are only rebuilt
+ * then. The lists are symmetric, i.e. j is listed for i and i for j, so every molecule can
+ * sum up its own forces without writing to the others.
+ */
+class NeighbourList {
+
+public:
+
+    NeighbourList() : builds(0), _radius(0.0), _skin(0.0) {}
+
+    /**
+     * Rebuilds the lists, if the molecules changed or one moved more than half the skin
+     * @param objects identity of the molecules, the lists are rebuilt if it changes
+     * @param centres of the molecules
+     * @param radius largest interaction radius of any pair
+     * @return true, if the lists were rebuilt
+     */
+    bool update(const std::vector<std::shared_ptr<SimulationObject>> &objects, const std::vector<Vector3> &centres,
+                double radius, double skin);
+
+    const uint32_t *begin(std::size_t i) const { return _neighbours.data() + _offsets[i]; }
+
+    const uint32_t *end(std::size_t i) const { return _neighbours.data() + _offsets[i + 1]; }
+
+    /**
+     * Returns the number of builds since the start
+     */
+    std::size_t getBuilds() const { return builds; }
+
+private:
+
+    void build(const std::vector<Vector3> &centres, double reach);
+
+    std::size_t builds;
+
+    std::vector<std::shared_ptr<SimulationObject>> _objects;   // at the last build
+    std::vector<Vector3> _reference;            // centres at the last build
+    double _radius;
+    double _skin;
+
+    std::vector<uint32_t> _offsets;             // of the list of each molecule, one more at the end
+    std::vector<uint32_t> _neighbours;
+
+    // grid of the build, kept to reuse the allocated memory
+    std::vector<uint32_t> _cellOf;
+    std::vector<uint32_t> _cellStart;
+    std::vector<uint32_t> _order;
+};
+
+/**
+ * Short range Lennard-Jones forces between the molecules. Two molecules of sizes s1 and s2
+ * are at rest at the distance 2^(1/6) sigma of their centres, sigma = (s1 + s2) / 2; they
+ * attract each other beyond up to the cutoff and repel each other below. Closer than
+ * LJ_MIN_DISTANCE sigma the force does not grow any further, the hard contact takes over.
+ */
+class LennardJones {
+
+public:
+
+    /**
+     * @param epsilon depth of the potential, in the units of the kinetic energy
+     * @param cutoff in multiples of sigma
+     * @param skin of the neighbour lists in pixels
+     */
+    LennardJones(double epsilon, double cutoff, double skin) : epsilon(epsilon), cutoff(cutoff), skin(skin) {}
+
+    /**
+     * Computes the force on every molecule in parallel
+     * @param due indices of the only molecules which need their force, e.g. in a multi-rate
+     * substep, nullptr for all. The forces of the others keep their last value.
+     */
+    void compute(SimulationObjects &objects, std::size_t workers, const std::vector<uint32_t> *due = nullptr);
+
+    /**
+     * Force on the i'th molecule of the last computation, if it is the given object
+     * @return false, if the molecules changed in the meantime
+     */
+    bool getForce(std::size_t i, const SimulationObject *object, Vector3 &force) const {
+        if (i >= _objects.size() || _objects[i].get() != object) return false;
+        force = _forces[i];
+        return true;
+    }
+
+    const NeighbourList &getNeighbourList() const { return _list; }
+
+    /**
+     * Potential energy of the molecules at the last computation, shifted to zero at the
+     * cutoff, so it is the negative work of the forces
+     */
+    double getPotentialEnergy() const;
+
+private:
+
+    /**
+     * Sums up the force on molecule i from its neighbour list
+     */
+    Vector3 force(std::size_t i) const;
+
+    double epsilon;
+    double cutoff;
+    double skin;
+
+    NeighbourList _list;
+    std::vector<std::shared_ptr<SimulationObject>> _objects;
+    std::vector<Vector3> _centres;
+    std::vector<double> _sizes;
+    std::vector<Vector3> _forces;
+};
+
+#endif //COLLISIONSIM_INTERACTIONS_H
@@ -0,0 +1,101 @@
+//
+// Created by Trebing, Peter on 2019-09-19.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "lockProfiler.h"
+
+std::atomic<bool> LockProfiler::enabled(true);
+std::mutex LockProfiler::registryMutex;
+
+namespace {
+
+void updateMax(std::atomic<uint64_t> &max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+}
+
+LockSite::LockSite(const char *name) :
+        name(name),
+        acquisitions(0),
+        contended(0),
+        waitNs(0),
+        maxWaitNs(0),
+        holdNs(0),
+        maxHoldNs(0),
+        blockedNs(0) {
+    std::lock_guard<std::mutex> uLock(LockProfiler::registryMutex);
+    LockProfiler::registry().push_back(this);
+}
+
+void LockSite::record(uint64_t waited, uint64_t held, bool wasContended) {
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (wasContended) {
+        contended.fetch_add(1, std::memory_order_relaxed);
+        waitNs.fetch_add(waited, std::memory_order_relaxed);
+        updateMax(maxWaitNs, waited);
+    }
+    holdNs.fetch_add(held, std::memory_order_relaxed);
+    updateMax(maxHoldNs, held);
+}
+
+std::vector<LockSite *> &LockProfiler::registry() {
+    // constructed on first use, sites may be statics of other translation units
+    static std::vector<LockSite *> sites;
+    return sites;
+}
+
+std::vector<LockSiteStats> LockProfiler::snapshot() {
+    std::vector<LockSiteStats> result;
+    std::lock_guard<std::mutex> uLock(registryMutex);
+    for (LockSite *site: registry()) {
+        result.push_back(LockSiteStats{site->name,
+                                       site->acquisitions.load(std::memory_order_relaxed),
+                                       site->contended.load(std::memory_order_relaxed),
+                                       site->waitNs.load(std::memory_order_relaxed),
+                                       site->maxWaitNs.load(std::memory_order_relaxed),
+                                       site->holdNs.load(std::memory_order_relaxed),
+                                       site->maxHoldNs.load(std::memory_order_relaxed),
+                                       site->blockedNs.load(std::memory_order_relaxed)});
+    }
+    return result;
+}
+
+std::vector<LockSiteStats> LockProfiler::difference(const std::vector<LockSiteStats> &now,
+                                                    const std::vector<LockSiteStats> &earlier) {
+    std::vector<LockSiteStats> result = now;
+    // sites are only appended to the registry, so the order of both snapshots is the same
+    for (std::size_t i = 0; i < earlier.size() && i < result.size(); i++) {
+        result[i].acquisitions -= earlier[i].acquisitions;
+        result[i].contended -= earlier[i].contended;
+        result[i].waitNs -= earlier[i].waitNs;
+        result[i].holdNs -= earlier[i].holdNs;
+        result[i].blockedNs -= earlier[i].blockedNs;
+        // the maximum can not be split into intervals, it stays cumulative
+    }
+    return result;
+}
+
+std::string LockProfiler::report(std::vector<LockSiteStats> stats) {
+    stats.erase(std::remove_if(stats.begin(), stats.end(),
+                               [](const LockSiteStats &s) { return s.acquisitions == 0; }),
+                stats.end());
+    std::sort(stats.begin(), stats.end(), [](const LockSiteStats &a, const LockSiteStats &b) {
+        return a.blockedNs != b.blockedNs ? a.blockedNs > b.blockedNs : a.holdNs > b.holdNs;
+    });
+    std::ostringstream out;
+    out.precision(2);
+    out << std::fixed;
+    for (const LockSiteStats &s: stats) {
+        out << "\n  " << s.name << ": n=" << s.acquisitions
+            << " contended=" << 100.0 * s.contended / s.acquisitions << "%"
+            << " wait=" << s.waitNs / 1e6 << "ms (max " << s.maxWaitNs / 1e3 << "us)"
+            << " hold=" << s.holdNs / 1e6 << "ms (max " << s.maxHoldNs / 1e3 << "us)"
+            << " blocked others=" << s.blockedNs / 1e6 << "ms";
+    }
+    return out.str();
+}
@@ -0,0 +1,109 @@
+//
+// Created by Trebing, Peter on 2019-09-19.
+//
+
+#ifndef COLLISIONSIM_LOCKPROFILER_H
+#define COLLISIONSIM_LOCKPROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Contention statistics of one place in the code which locks a SynchronizedList.
+ * Sites are meant to be function local statics, they register themselves and live as
+ * long as the process:
+ *
+ *   static LockSite site("Renderer::render");
+ *   particles.map(..., &site);
+ */
+class LockSite {
+
+public:
+
+    LockSite(const char *name);
+
+    LockSite(const LockSite &) = delete;
+
+    LockSite &operator=(const LockSite &) = delete;
+
+    const char *getName() const { return name; }
+
+    /**
+     * Records one outermost acquisition of the lock
+     * @param waited nanoseconds spent waiting for the lock
+     * @param held nanoseconds the lock was held
+     */
+    void record(uint64_t waited, uint64_t held, bool contended);
+
+    /**
+     * Adds time other sites spent waiting while this site held the lock
+     */
+    void addBlocked(uint64_t nanoseconds) { blockedNs.fetch_add(nanoseconds, std::memory_order_relaxed); }
+
+private:
+    friend class LockProfiler;
+
+    const char *name;
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> waitNs;
+    std::atomic<uint64_t> maxWaitNs;
+    std::atomic<uint64_t> holdNs;
+    std::atomic<uint64_t> maxHoldNs;
+    std::atomic<uint64_t> blockedNs;
+};
+
+/**
+ * Statistics of a site at the time of a snapshot
+ */
+struct LockSiteStats {
+    const char *name;
+    uint64_t acquisitions;
+    uint64_t contended;     // acquisitions which had to wait
+    uint64_t waitNs;        // time spent waiting for the lock
+    uint64_t maxWaitNs;
+    uint64_t holdNs;        // time the lock was held
+    uint64_t maxHoldNs;
+    uint64_t blockedNs;     // time other sites waited while this site held the lock
+};
+
+/**
+ * Registry of all lock sites
+ */
+class LockProfiler {
+
+public:
+
+    static void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns the cumulative statistics of all sites
+     */
+    static std::vector<LockSiteStats> snapshot();
+
+    /**
+     * Returns the statistics of the interval between two snapshots
+     */
+    static std::vector<LockSiteStats> difference(const std::vector<LockSiteStats> &now,
+                                                 const std::vector<LockSiteStats> &earlier);
+
+    /**
+     * Returns a report of all sites which acquired the lock, sorted by the time they
+     * blocked other sites, i.e. the site starving the others comes first
+     */
+    static std::string report(std::vector<LockSiteStats> stats);
+
+private:
+    friend class LockSite;
+
+    static std::atomic<bool> enabled;
+    static std::mutex registryMutex;
+    static std::vector<LockSite *> &registry();
+};
+
+#endif //COLLISIONSIM_LOCKPROFILER_H
@@ -3,13 +3,29 @@
 #include "simulation.h"
 #include "renderer.h"
 #include "configuration.h"
+#include "checkpoint.h"
+#include "trajectoryPlayer.h"
 
 std::string Configuration::DEFAULT_CONFIGFILE = "simulation_config.txt";
 
-int main() {
+int main(int argc, char **argv) {
 
-    // Read the configuration file
+    // Read the configuration file, key=value arguments override it
     Configuration config;
+    std::string overrides;
+    if (!Configuration::parseArguments(argc, argv, overrides)) return 1;
+    config.merge(overrides);
+
+    // Resume a previous run, the configuration stored in the checkpoint takes precedence
+    // over the file, but not over the command line
+    std::unique_ptr<Checkpoint> checkpoint;
+    if (config.getCheckpointRestore()) {
+        checkpoint = Checkpoint::open(config.getCheckpointFile());
+        if (checkpoint) {
+            config.merge(checkpoint->getConfiguration(), "checkpoint_");
+            config.merge(overrides);
+        }
+    }
 
     std::size_t kMsPerFrame{1000 / config.getFPS()};
     std::size_t kGridWidth = config.getWindowWidth();
@@ -18,7 +34,21 @@ int main() {
     // Initialize a render object
     Renderer renderer(config);
     Controller controller;
+
+    // Replay a recorded trajectory instead of simulating
+    if (!config.getReplayFile().empty()) {
+        TrajectoryPlayer player(config);
+        if (!player.open(config.getReplayFile())) return 1;
+        player.Run(controller, renderer, kMsPerFrame);
+        std::cout << "Replay has terminated successfully!\n";
+        return 0;
+    }
+
     Simulation game(config);
+    if (checkpoint) {
+        game.Restore(*checkpoint);
+        checkpoint.reset();
+    }
     game.Run(controller, renderer, kMsPerFrame);
 
     std::cout << "Simulation has terminated successfully!\n";
@@ -0,0 +1,79 @@
+//
+// Created by Trebing, Peter on 2019-09-14.
+//
+
+#ifndef COLLISIONSIM_MAPPEDFILE_H
+#define COLLISIONSIM_MAPPEDFILE_H
+
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Read only memory mapping of a whole file (RAII). The mapping is released on destruction.
+ */
+class MappedFile {
+
+public:
+
+    MappedFile() : data(nullptr), length(0) {}
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    /**
+     * Maps the specified file into memory
+     * @param filename name of the file
+     * @return false if the file could not be mapped
+     */
+    bool open(const std::string &filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Couldn't open " << filename << " for reading.\n";
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            std::cerr << "Couldn't determine size of " << filename << ".\n";
+            ::close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Couldn't map " << filename << " into memory.\n";
+            return false;
+        }
+        data = static_cast<const char *>(mapped);
+        length = static_cast<std::size_t>(info.st_size);
+        return true;
+    }
+
+    void close() {
+        if (data != nullptr) {
+            munmap(const_cast<char *>(data), length);
+            data = nullptr;
+            length = 0;
+        }
+    }
+
+    const char *getData() const { return data; }
+
+    std::size_t size() const { return length; }
+
+private:
+    const char *data;
+    std::size_t length;
+};
+
+#endif //COLLISIONSIM_MAPPEDFILE_H
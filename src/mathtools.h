@@ -31,6 +31,22 @@
  */
 extern double sleepEpsilon;
 
+/**
+ * Sets the current sleep epsilon value: the kinetic energy threshold
+ * under which a particle is put to sleep. A value of zero or below
+ * keeps all particles awake.
+ *
+ * @param value The sleep epsilon value to use from this point on.
+ */
+void setSleepEpsilon(double value);
+
+/**
+ * Gets the current value of the sleep epsilon parameter.
+ *
+ * @return The current value of the parameter.
+ */
+double getSleepEpsilon();
+
 /**
  * Holds a vector in 3 dimensions. Four data members are allocated
  * to ensure alignment in an array.
@@ -8,24 +8,38 @@
 
 class N2 : public Molecule {
 public:
-    N2() : Molecule({0, 102, 153, 255}, 6) {
+    N2() : Molecule(nitrogen, {0, 102, 153, 255}, 6) {
         part.setMass(50.0 * 14.0067);
     }
 };
 
 class O2 : public Molecule {
 public:
-    O2() : Molecule({255, 102, 52, 255}, 4) {
+    O2() : Molecule(oxygen, {255, 102, 52, 255}, 4) {
         part.setMass(10.0 * 14.0067);
     }
 };
 
 class CO2 : public Molecule {
 public:
-    CO2() : Molecule({0, 0, 0, 255}, 16) {
+    CO2() : Molecule(carbonDioxide, {0, 0, 0, 255}, 16) {
         sensitivity = sensitive;
         part.setMass(100.0 * 14.0067);
     }
 };
 
+/**
+ * Creates a new molecule of the given species, e.g. when restoring a checkpoint
+ */
+inline Molecule *createMolecule(Species species) {
+    switch (species) {
+        case oxygen:
+            return new O2();
+        case carbonDioxide:
+            return new CO2();
+        default:
+            return new N2();
+    }
+}
+
 #endif //COLLISIONSIM_MOLECULES_H
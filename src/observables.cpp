@@ -0,0 +1,120 @@
+//
+// Created by Trebing, Peter on 2019-09-24.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include "observables.h"
+
+ObservableSums::ObservableSums() : momentumX(0.0), momentumY(0.0), wallImpulse(0.0), asleep(0), integrated(0),
+                                   maxSpeedSquared(0.0), minSize(std::numeric_limits<std::size_t>::max()) {
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        count[s] = 0;
+        kineticEnergy[s] = 0.0;
+    }
+}
+
+void ObservableSums::add(const ObservableSums &other) {
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        count[s] += other.count[s];
+        kineticEnergy[s] += other.kineticEnergy[s];
+    }
+    momentumX += other.momentumX;
+    momentumY += other.momentumY;
+    wallImpulse += other.wallImpulse;
+    asleep += other.asleep;
+    integrated += other.integrated;
+    maxSpeedSquared = std::max(maxSpeedSquared, other.maxSpeedSquared);
+    minSize = std::min(minSize, other.minSize);
+}
+
+Observables::Observables() :
+        steps(0), momentumX(0.0), momentumY(0.0), wallImpulse(0.0), time(0.0), collisionEnergyChange(0.0),
+        asleep(0), maxSpeed(0.0), minSize(0), timestep(0.0), substeps(1),
+        integrations(0) {
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        count[s] = 0;
+        kineticEnergy[s] = 0.0;
+    }
+}
+
+void Observables::update(const ObservableSums &sums, double duration) {
+    ++steps;
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        count[s] = sums.count[s];
+        kineticEnergy[s] = sums.kineticEnergy[s];
+    }
+    momentumX = sums.momentumX;
+    momentumY = sums.momentumY;
+    wallImpulse += sums.wallImpulse;
+    asleep = sums.asleep;
+    integrations += sums.integrated;
+    maxSpeed = std::sqrt(sums.maxSpeedSquared);
+    minSize = sums.minSize == std::numeric_limits<std::size_t>::max() ? 0 : sums.minSize;
+    timestep = duration;
+    time += duration;
+}
+
+void Observables::advance(const ObservableSums &sums, double duration) {
+    ++steps;
+    wallImpulse += sums.wallImpulse;
+    integrations += sums.integrated;
+    timestep = duration;
+    time += duration;
+}
+
+double Observables::temperature(Species species) const {
+    return count[species] > 0 ? kineticEnergy[species] / static_cast<double>(count[species]) : 0.0;
+}
+
+double Observables::temperature() const {
+    double energy = 0.0;
+    std::size_t total = 0;
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        energy += kineticEnergy[s];
+        total += count[s];
+    }
+    return total > 0 ? energy / static_cast<double>(total) : 0.0;
+}
+
+double Observables::pressure(const Observables &earlier, double perimeter) const {
+    double interval = time - earlier.time;
+    if (interval <= 0.0 || perimeter <= 0.0) return 0.0;
+    return (wallImpulse - earlier.wallImpulse) / (interval * perimeter);
+}
+
+std::string Observables::summary(const Observables &earlier, double perimeter) const {
+    std::ostringstream out;
+    out.precision(4);
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        out << "T_" << speciesName(static_cast<Species>(s)) << "=" << temperature(static_cast<Species>(s)) << " ";
+    }
+    out << "T=" << temperature() << " p=(" << momentumX << "," << momentumY << ")"
+        << " P=" << pressure(earlier, perimeter)
+        << " dE_coll=" << collisionEnergyChange - earlier.collisionEnergyChange << " asleep=" << asleep
+        << " v_max=" << maxSpeed << " dt=" << timestep * 1000.0 << "ms substeps=" << substeps;
+    return out.str();
+}
+
+std::string Observables::title(const Observables &earlier, double perimeter) const {
+    std::ostringstream out;
+    out.precision(3);
+    out << "T " << temperature() << " | P " << pressure(earlier, perimeter)
+        << " | |p| " << std::sqrt(momentumX * momentumX + momentumY * momentumY)
+        << " | dt " << timestep * 1000.0 << "ms x" << substeps;
+    return out.str();
+}
+
+const char *Observables::speciesName(Species species) {
+    switch (species) {
+        case nitrogen:
+            return "N2";
+        case oxygen:
+            return "O2";
+        case carbonDioxide:
+            return "CO2";
+    }
+    return "?";
+}
@@ -0,0 +1,98 @@
+//
+// Created by Trebing, Peter on 2019-09-24.
+//
+
+#ifndef COLLISIONSIM_OBSERVABLES_H
+#define COLLISIONSIM_OBSERVABLES_H
+
+#include <string>
+#include "simulationObject.h"
+
+/**
+ * Sums gathered by one worker during a pass over the molecules. The partial sums of all
+ * workers are added up at the end of the pass.
+ */
+struct ObservableSums {
+    std::size_t count[SPECIES_COUNT];
+    double kineticEnergy[SPECIES_COUNT];
+    double momentumX;
+    double momentumY;
+    double wallImpulse;
+    std::size_t asleep;
+    std::size_t integrated;         // number of molecules integrated in this pass
+    double maxSpeedSquared;         // of the awake molecules, for the time step control
+    std::size_t minSize;
+
+    ObservableSums();
+
+    void add(const ObservableSums &other);
+};
+
+/**
+ * Thermodynamic state of the gas, published by the physics after every integration step.
+ * Kinetic energy and momentum describe the last step; wall impulse, simulated time and the
+ * energy change by collisions are cumulative, so the difference of two snapshots yields
+ * the pressure of the interval in between.
+ */
+class Observables {
+
+public:
+
+    Observables();
+
+    std::size_t steps;
+    std::size_t count[SPECIES_COUNT];
+    double kineticEnergy[SPECIES_COUNT];
+    double momentumX;
+    double momentumY;
+    double wallImpulse;             // cumulative impulse of all wall reflections
+    double time;                    // cumulative simulated time in seconds
+    double collisionEnergyChange;   // cumulative, non zero if the collisions are not elastic
+    std::size_t asleep;             // number of sleeping molecules
+    double maxSpeed;
+    std::size_t minSize;            // size of the smallest molecule
+    double timestep;                // duration of the last integration step in seconds
+    std::size_t substeps;           // number of integration steps of the last physics tick
+    std::size_t integrations;       // cumulative number of integrated molecules
+
+    /**
+     * Takes over the instantaneous values of a pass and adds its wall impulse
+     */
+    void update(const ObservableSums &sums, double duration);
+
+    /**
+     * Adds the wall impulse and the integrations of a pass which only visited some of the
+     * molecules, the instantaneous values of the last complete pass are kept
+     */
+    void advance(const ObservableSums &sums, double duration);
+
+    /**
+     * Mean kinetic energy of a species, i.e. its temperature in simulation units
+     */
+    double temperature(Species species) const;
+
+    /**
+     * Mean kinetic energy of all molecules
+     */
+    double temperature() const;
+
+    /**
+     * Force per length of wall since an earlier snapshot
+     * @param perimeter length of all walls of the box
+     */
+    double pressure(const Observables &earlier, double perimeter) const;
+
+    /**
+     * Returns a one line summary of temperatures, momentum and pressure
+     */
+    std::string summary(const Observables &earlier, double perimeter) const;
+
+    /**
+     * Returns a compact summary to be shown in the window title
+     */
+    std::string title(const Observables &earlier, double perimeter) const;
+
+    static const char *speciesName(Species species);
+};
+
+#endif //COLLISIONSIM_OBSERVABLES_H
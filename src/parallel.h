@@ -0,0 +1,42 @@
+//
+// Created by Trebing, Peter on 2019-09-17.
+//
+
+#ifndef COLLISIONSIM_PARALLEL_H
+#define COLLISIONSIM_PARALLEL_H
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * Returns the number of worker threads to use, 0 means one per hardware thread
+ */
+inline std::size_t workerCount(std::size_t configured) {
+    if (configured > 0) return configured;
+    return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+/**
+ * Splits the range 0..count into contiguous blocks and processes them in parallel. The
+ * last block is processed by the calling thread, which waits for all others.
+ * @param count number of items
+ * @param workers number of threads to use
+ * @param f function called with the block [begin, end) and the number of the worker
+ */
+inline void parallelFor(std::size_t count, std::size_t workers,
+                        const std::function<void(std::size_t begin, std::size_t end, std::size_t worker)> &f) {
+    workers = std::max<std::size_t>(std::min(workers, count), 1);
+    std::size_t block = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    for (std::size_t w = 0; w + 1 < workers; w++) {
+        threads.emplace_back(f, std::min(count, w * block), std::min(count, (w + 1) * block), w);
+    }
+    f(std::min(count, (workers - 1) * block), count, workers - 1);
+    for (auto &t: threads) {
+        t.join();
+    }
+}
+
+#endif //COLLISIONSIM_PARALLEL_H
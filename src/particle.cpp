@@ -8,8 +8,8 @@
 
 void Particle::integrate(double duration) {
 
-    // We don't integrate things with zero mass.
-    if (inverseMass <= 0.0f) return;
+    // We don't integrate things with zero mass or which are asleep.
+    if (inverseMass <= 0.0f || !isAwake) return;
 
     // Integrate only if some time passed
     if (duration <= 0.0f) return;
@@ -31,6 +31,88 @@ void Particle::integrate(double duration) {
     // Clear the forces.
     clearAccumulator();
 
+    // Update the kinetic energy average and possibly put the particle to sleep.
+    if (sleepEpsilon > 0.0) updateMotion(pow(0.5, duration));
+
+}
+
+void Particle::integrateVerlet(double duration, double dampingFactor, double sleepBias) {
+
+    // We don't integrate things with zero mass or which are asleep.
+    if (inverseMass <= 0.0f || !isAwake) return;
+
+    // Integrate only if some time passed
+    if (duration <= 0.0f) return;
+
+    // Work out the acceleration from the force
+    Vector3 resultingAcc = acceleration;
+    resultingAcc.addScaledVector(forceAccum, inverseMass);
+
+    // For a constant acceleration the position is exact.
+    position.addScaledVector(velocity, duration);
+    position.addScaledVector(resultingAcc, 0.5 * duration * duration);
+
+    // The acceleration does not depend on the position, so both velocity
+    // half steps use the same one.
+    velocity.addScaledVector(resultingAcc, duration);
+
+    // Impose drag.
+    velocity *= dampingFactor;
+
+    // Clear the forces.
+    clearAccumulator();
+
+    if (sleepEpsilon > 0.0) updateMotion(sleepBias);
+
+}
+
+void Particle::kickDrift(double duration) {
+
+    // We don't integrate things with zero mass or which are asleep.
+    if (inverseMass <= 0.0f || !isAwake) return;
+
+    // Integrate only if some time passed
+    if (duration <= 0.0f) return;
+
+    Vector3 resultingAcc = acceleration + forceAcceleration;
+    velocity.addScaledVector(resultingAcc, 0.5 * duration);
+    position.addScaledVector(velocity, duration);
+}
+
+void Particle::finishVerlet(double duration, double dampingFactor, double sleepBias) {
+
+    // We don't integrate things with zero mass or which are asleep.
+    if (inverseMass <= 0.0f || !isAwake) return;
+
+    // Integrate only if some time passed
+    if (duration <= 0.0f) return;
+
+    // The forces at the new position, the next step starts with them
+    forceAcceleration = forceAccum * inverseMass;
+    Vector3 resultingAcc = acceleration + forceAcceleration;
+    velocity.addScaledVector(resultingAcc, 0.5 * duration);
+
+    // Impose drag.
+    velocity *= dampingFactor;
+
+    // Clear the forces.
+    clearAccumulator();
+
+    if (sleepEpsilon > 0.0) updateMotion(sleepBias);
+
+}
+
+void Particle::updateMotion(double bias) {
+    double currentMotion = 0.5 * velocity.squareMagnitude() / inverseMass;
+    motion = bias * motion + (1.0 - bias) * currentMotion;
+
+    if (motion < sleepEpsilon) isAwake = false;
+    else if (motion > 10.0 * sleepEpsilon) motion = 10.0 * sleepEpsilon;
+}
+
+void Particle::setAwake(const bool awake) {
+    isAwake = awake;
+    if (awake) motion = 2.0 * sleepEpsilon;
 }
 
 void Particle::setMass(const double mass) {
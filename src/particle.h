@@ -16,8 +16,11 @@ public:
         setPosition(nullVector);
         setVelocity(nullVector);
         setAcceleration(nullVector);
+        forceAcceleration = nullVector;
         setDamping(1.0f);
         setMass(1.0f);
+        isAwake = true;
+        motion = 2.0 * sleepEpsilon;
     }
 
 protected:
@@ -109,6 +112,27 @@ protected:
      */
     Vector3 acceleration;
 
+    /**
+     * Holds the acceleration by the accumulated forces at the end
+     * of the last split Verlet step, which the first half kick of
+     * the next step uses.
+     */
+    Vector3 forceAcceleration;
+
+    /**
+     * Holds the recency weighted average of the kinetic energy of
+     * the particle. A particle whose average stays below
+     * sleepEpsilon is put to sleep.
+     */
+    double motion;
+
+    /**
+     * A particle can be put to sleep to avoid it being updated
+     * by the integration functions or affected by collisions
+     * with other sleeping particles.
+     */
+    bool isAwake;
+
 public:
     /**
      * @name Constructor and Destructor
@@ -140,6 +164,63 @@ public:
      */
     void integrate(double duration);
 
+    /**
+     * Integrates the particle forward in time by the given amount with
+     * the velocity Verlet method. It is symplectic and exact for a
+     * constant acceleration like gravity, so it stays stable with
+     * larger steps than the Newton-Euler method. Forces which depend
+     * on the position need the split step of kickDrift and
+     * finishVerlet instead.
+     *
+     * @param dampingFactor The drag of the step, i.e. damping to the
+     * power of duration. Particles sharing the damping and the step
+     * share the factor, so it is computed once per step.
+     *
+     * @param sleepBias The weight of the previous motion, i.e. 0.5 to
+     * the power of duration.
+     */
+    void integrateVerlet(double duration, double dampingFactor, double sleepBias);
+
+    /**
+     * First half of a velocity Verlet step with forces which depend
+     * on the position: kicks the velocity by half the duration with
+     * the acceleration of the last step and drifts the position by
+     * the whole duration. The forces at the new position are then
+     * accumulated and finishVerlet completes the step.
+     */
+    void kickDrift(double duration);
+
+    /**
+     * Second half of a velocity Verlet step started by kickDrift:
+     * kicks the velocity by half the duration with the constant
+     * acceleration plus the accumulated forces, keeps their
+     * acceleration for the next kickDrift and imposes drag.
+     *
+     * @param dampingFactor see integrateVerlet.
+     *
+     * @param sleepBias see integrateVerlet.
+     */
+    void finishVerlet(double duration, double dampingFactor, double sleepBias);
+
+    /**
+     * Returns true if the particle is awake and responding to
+     * integration.
+     */
+    bool getAwake() const { return isAwake; }
+
+    /**
+     * Sets the awake state of the particle. A woken particle gets
+     * a motion above the threshold, so it is not put to sleep
+     * again by the next integration. The velocity is kept while
+     * the particle sleeps, so waking it up restores it.
+     */
+    void setAwake(const bool awake = true);
+
+    /**
+     * Gets the recency weighted average kinetic energy.
+     */
+    double getMotion() const { return motion; }
+
     /**
      * @name Accessor Functions for the Particle's State
      *
@@ -336,6 +417,14 @@ public:
      */
     void addForce(const Vector3 &force);
 
+private:
+
+    /**
+     * Updates the recency weighted average of the kinetic energy and
+     * puts the particle to sleep, if it falls below sleepEpsilon.
+     */
+    void updateMotion(double bias);
+
 };
 
 
@@ -2,55 +2,25 @@
 // Created by Trebing, Peter on 2019-08-27.
 //
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include <thread>
 #include <utility>
 #include "particlePhysics2D.h"
+#include "profiler.h"
+#include "perfCounters.h"
 
-// Representation of a point in 2D
-struct Point {
-    double x, y;
-};
-
-/** Checks if two rectangles do intersect - used to check for collision
- * @param l1 left upper point of rechtangle 1
- * @param r1 right lower point of rechtangle 1
- * @param l2 left upper point of rechtangle 2
- * @param r2 right lower point of rechtangle 2
- */
-bool hasIntersection(Point l1, Point r1, Point l2, Point r2) {
-
-    // If one rectangle is on left side of other
-    if (l1.x > r2.x || l2.x > r1.x)
-        return false;
-
-    // If one rectangle is above other
-    if (l1.y > r2.y || l2.y > r1.y)
-        return false;
-
-    return true;
-}
+namespace {
 
-/**
- * Computes the necessary displacement of two rectangles after collsion - to prevent
- * detecting a collision over and over again
- * @param l1 left upper point of rechtangle 1
- * @param r1 right lower point of rechtangle 1
- * @param l2 left upper point of rechtangle 3
- * @param r2 right lower point of rechtangle 2
- * @return a vector instance representing  the displacement in component x and y (z will always be 0)
- */
-Vector3 getDisplacement(Point l1, Point r1, Point l2, Point r2) {
+// molecules faster than this multiple of the RMS speed are searched first under overload
+const double FAST_SPEED_FACTOR = 2.0;
 
-    Vector3 result;
+// Minimum number of molecules per thread of the integration. Below, starting a thread
+// costs more than it saves.
+const std::size_t PARALLEL_GRAIN = 8192;
 
-    result.x = (std::min(r1.x, r2.x) -
-                std::max(l1.x, l2.x));
-
-    result.y = (std::min(r1.y, r2.y) -
-                std::max(l1.y, l2.y));
-
-    result.z = 0;
-    return result;
 }
 
 void PatrticlePhysics2D::run() {
@@ -65,6 +35,18 @@ void PatrticlePhysics2D::run() {
         // sleep at every iteration to reduce CPU usage
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
+        if (config.getTimestepCfl() > 0.0) {
+            // wait as long as the molecules allow, but at least the physics interval
+            std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
+            double elapsed = std::chrono::duration<double>(now - lastUpdate).count();
+            double interval = static_cast<double>(config.getPhysicIntervalMs()) / 1000.0;
+            if (elapsed >= std::max(interval, std::min(stableTimestep(), config.getTimestepMaxMs() / 1000.0))) {
+                advance(elapsed);
+                lastUpdate = now;
+            }
+            continue;
+        }
+
         // compute time difference to stop watch
         long timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::system_clock::now() - lastUpdate).count();
@@ -79,6 +61,48 @@ void PatrticlePhysics2D::run() {
 
 }
 
+double PatrticlePhysics2D::stableTimestep() {
+    std::lock_guard<std::mutex> uLock(_mutex);
+    double maxStep = config.getTimestepMaxMs() / 1000.0;
+    // the speeds are not known before the first step
+    if (observables.steps == 0) return std::min(maxStep, 0.001);
+    if (observables.maxSpeed <= 0.0) return maxStep;
+    return std::min(maxStep, config.getTimestepCfl() * static_cast<double>(observables.minSize) / observables.maxSpeed);
+}
+
+void PatrticlePhysics2D::advance(double elapsed) {
+
+    // Split the elapsed time into steps in which no molecule moves further than the
+    // configured fraction of the smallest molecule, so none can pass through another
+    // between two collision passes. Beyond the maximum number of substeps the remaining
+    // time is dropped, i.e. the simulation runs slower instead of inaccurately.
+    double stable = stableTimestep();
+    std::size_t maxSubsteps = std::max<std::size_t>(config.getTimestepMaxSubsteps(), 1);
+    std::size_t substeps = static_cast<std::size_t>(std::ceil(elapsed / stable));
+    substeps = std::min(std::max<std::size_t>(substeps, 1), maxSubsteps);
+    if (config.getTimestepMultirate()) {
+        // the strides of the objects must divide the tick
+        std::size_t power = 1;
+        while (power < substeps && power * 2 <= maxSubsteps) power *= 2;
+        substeps = power;
+    }
+    double duration = std::min(elapsed / static_cast<double>(substeps), stable);
+
+    for (std::size_t s = 0; s < substeps; s++) {
+        if (config.getTimestepMultirate()) integrate(duration, s + 1, substeps);
+        else integrate(duration);
+        // the collider thread handles the last substep
+        if (s + 1 < substeps) {
+            std::size_t collisionsDetected = detectCollisions();
+            std::lock_guard<std::mutex> uLock(_mutex);
+            collisions += collisionsDetected;
+        }
+    }
+
+    std::lock_guard<std::mutex> uLock(_mutex);
+    observables.substeps = substeps;
+}
+
 void PatrticlePhysics2D::collider() {
 
     std::chrono::time_point<std::chrono::system_clock> lastUpdate;
@@ -99,6 +123,7 @@ void PatrticlePhysics2D::collider() {
         if (timeSinceLastUpdate >= config.getPhysicIntervalMs()) {
             std::size_t collisionsDetected = detectCollisions();
             lastUpdate = std::chrono::system_clock::now();
+            std::lock_guard<std::mutex> uLock(_mutex);
             collisions += collisionsDetected;
         }
 
@@ -106,39 +131,110 @@ void PatrticlePhysics2D::collider() {
 
 }
 
+void PatrticlePhysics2D::step(double duration) {
+    if (config.getTimestepCfl() > 0.0) advance(duration);
+    else integrate(duration);
+    std::size_t collisionsDetected = detectCollisions();
+    std::lock_guard<std::mutex> uLock(_mutex);
+    collisions += collisionsDetected;
+}
+
 PatrticlePhysics2D::~PatrticlePhysics2D() {
 }
 
-void PatrticlePhysics2D::integrate(double duration) {
+void PatrticlePhysics2D::integrate(double duration, std::size_t substep, std::size_t substeps) {
 
     std::size_t width = config.getWindowWidth();
     std::size_t height = config.getWindowHeight();
+    // distance an object may travel in its stable step
+    double travel;
+    {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        travel = config.getTimestepCfl() * static_cast<double>(observables.minSize);
+    }
+
+    // Drag and sleep bias for the durations of this pass, multiples of the substep, so the
+    // Verlet integration needs no pow per molecule
+    std::vector<double> dampingFactors(substep + 1, 1.0), sleepBiases(substep + 1, 1.0);
+    double damping = config.getDamping();
+    if (verlet) {
+        for (std::size_t k = 1; k <= substep; k++) {
+            dampingFactors[k] = std::pow(damping, static_cast<double>(k) * duration);
+            sleepBiases[k] = std::pow(0.5, static_cast<double>(k) * duration);
+        }
+    }
+
+    // record the integrated state within the same pass, if this step is part of the trajectory
+    TrajectoryWriter *writer = trajectory;
+    TrajectoryFrame *frame = writer != nullptr ? writer->acquire(steps) : nullptr;
+
+    // every worker reduces the observables of its block, so they cost no extra pass
+    std::vector<ObservableSums> sums(workers);
+
+    static LockSite site("PatrticlePhysics2D::integrate");
+    ScopedTimer timer(phaseIntegrate);
+    CounterScope counters(phaseIntegrate, 0);
+
+    LennardJones *interactions = _interactions.get();
+    // Velocity Verlet with short range forces splits the step: kick and drift with the forces
+    // of the last step, then the second kick with the forces at the new positions
+    bool split = verlet && interactions != nullptr;
+
+    // every object is due at the end of the tick, slow ones only then
+    auto isDue = [duration, substep, substeps](SimulationObject &obj) -> bool {
+        return substep == substeps ||
+               substep % (std::size_t(1) << strideLevel(obj.getStableStep(), duration, substeps)) == 0;
+    };
 
-    _particles.map([duration, width, height](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+    // integrates a due object and reflects it at the walls
+    auto integrateDue = [this, duration, substep, substeps, travel, damping, width, height, interactions, split,
+            &dampingFactors, &sleepBiases](std::shared_ptr<SimulationObject> &obj, size_t i, ObservableSums &sum) {
 
         Particle &part = obj->getParticle();
         size_t size = obj->getSize();
+        double mass = part.getMass();
 
-        part.integrate(duration);
+        // Molecules added since the computation get no force. Sleeping ones are not
+        // integrated and must not accumulate forces, lj_epsilon disables sleeping.
+        Vector3 force;
+        if (interactions != nullptr && part.getAwake() && interactions->getForce(i, obj.get(), force)) {
+            part.addForce(force);
+        }
+        std::size_t k = substep - obj->getLastSubstep();
+        double dampingFactor = part.getDamping() == damping ? dampingFactors[k] :
+                               std::pow(part.getDamping(), k * duration);
+        if (!verlet) {
+            part.integrate(static_cast<double>(k) * duration);
+        } else if (split) {
+            part.finishVerlet(static_cast<double>(k) * duration, dampingFactor, sleepBiases[k]);
+        } else {
+            part.integrateVerlet(static_cast<double>(k) * duration, dampingFactor, sleepBiases[k]);
+        }
+        obj->setLastSubstep(substep == substeps ? 0 : substep);
+        ++sum.integrated;
 
         Vector3 position = part.getPosition();
         Vector3 velocity = part.getVelocity();
         bool boxCollision = false;
         if (position.x <= 0.0) {
+            sum.wallImpulse += 2.0 * mass * std::abs(velocity.x);
             velocity.x *= -1.0;
             position.x = 0.0f;
             // position.x = grid_width;
             boxCollision = true;
         } else if (position.x + size > width) {
+            sum.wallImpulse += 2.0 * mass * std::abs(velocity.x);
             velocity.x *= -1.0;
             position.x = width - size;
             boxCollision = true;
         }
         if (position.y <= 0.0) {
+            sum.wallImpulse += 2.0 * mass * std::abs(velocity.y);
             velocity.y *= -1.0;
             position.y = 0.0f;
             boxCollision = true;
         } else if (position.y + size > height) {
+            sum.wallImpulse += 2.0 * mass * std::abs(velocity.y);
             velocity.y *= -1.0;
             position.y = height - size;
             boxCollision = true;
@@ -148,53 +244,338 @@ void PatrticlePhysics2D::integrate(double duration) {
             part.setPosition(position);
         }
 
-        return false;
-    });
+        double speed = std::sqrt(part.getVelocity().squareMagnitude());
+        obj->setStableStep(speed > 0.0 ? travel / speed : std::numeric_limits<double>::max());
+        _stableSteps[i] = obj->getStableStep();
+    };
+
+    // the frame is sized under the lock, so the workers only store into it
+    std::size_t count = 0;
+    bool complete = true;
+    _particles.synchronize([&]() {
+        count = _particles.size();
+
+        EnergyFactors energyFactors;
+        bool scaling = takeEnergyFactors(energyFactors);
+
+        // A multi-rate substep before the last one only visits the bins of the objects due in
+        // it. The last substep, heating, a trajectory frame or a changed list of objects need
+        // a pass over all objects, which publishes the observables of all and rebins them.
+        uint64_t version = _particles.version();
+        complete = substep == substeps || scaling || frame != nullptr || version != _binnedVersion;
+        if (complete) {
+            _stableSteps.resize(count);
+            if (frame != nullptr) writer->prepare(frame, count);
+        } else {
+            // the strides depend on the substep of this tick
+            if (_bins.empty()) rebin(duration, substeps);
+            // the bins whose stride divides the substep are due, they are binned again afterwards
+            _due.clear();
+            for (std::size_t level = 0; level < _bins.size() && substep % (std::size_t(1) << level) == 0; level++) {
+                _due.insert(_due.end(), _bins[level].begin(), _bins[level].end());
+                _bins[level].clear();
+            }
+        }
 
-}
+        // a heated or cooled molecule wakes up and is integrated in this substep
+        auto applyEnergy = [scaling, &energyFactors](SimulationObject &obj) {
+            if (scaling && energyFactors.apply(obj)) {
+                obj.getParticle().setAwake();
+                obj.setStableStep(0.0);
+            }
+        };
+        if (split) {
+            auto kickDrift = [substep, duration, &applyEnergy, &isDue](std::shared_ptr<SimulationObject> &obj,
+                                                                      size_t i, size_t worker) {
+                applyEnergy(*obj);
+                std::size_t k = substep - obj->getLastSubstep();
+                if (isDue(*obj)) obj->getParticle().kickDrift(static_cast<double>(k) * duration);
+            };
+            if (complete) _particles.parallelMap(workers, PARALLEL_GRAIN, kickDrift, &site);
+            else _particles.parallelMap(workers, PARALLEL_GRAIN, _due, kickDrift, &site);
+        }
 
-std::size_t PatrticlePhysics2D::detectCollisions() {
+        // short range forces at the positions before the step, after the drift if split
+        if (interactions != nullptr) interactions->compute(_particles, workers, complete ? nullptr : &_due);
 
-    // Count helps to fulfill the maximum collision limit
-    std::size_t checkCount = 0;
-    std::size_t collisionCount = 0;
+        if (!complete) {
+            _particles.parallelMap(workers, PARALLEL_GRAIN, _due, [&integrateDue, &sums](
+                    std::shared_ptr<SimulationObject> &obj, size_t i, size_t worker) {
+                integrateDue(obj, i, sums[worker]);
+            }, &site);
+            for (uint32_t i: _due) bin(i, strideLevel(_stableSteps[i], duration, substeps));
+            return;
+        }
 
-    _particles.map([&](std::shared_ptr<SimulationObject> &obj1, size_t i) -> bool {
+        _particles.parallelMap(workers, PARALLEL_GRAIN, [this, writer, frame, split, &applyEnergy, &isDue,
+                &integrateDue, &sums](std::shared_ptr<SimulationObject> &obj, size_t i, size_t worker) {
 
-        _particles.map([&](std::shared_ptr<SimulationObject> &obj2, size_t j) -> bool {
+            Particle &part = obj->getParticle();
+            double mass = part.getMass();
+            ObservableSums &sum = sums[worker];
 
-            if (++checkCount >= config.getCollisionLimit()) return true; //stop map
-            if (i == j) return false; // do not collide particle with itself, but continue
+            if (!split) applyEnergy(*obj);
+            if (isDue(*obj)) integrateDue(obj, i, sum);
+            _stableSteps[i] = obj->getStableStep();
 
-            Particle &part1 = obj1->getParticle();
-            Particle &part2 = obj2->getParticle();
+            Vector3 velocity = part.getVelocity();
+            if (!part.getAwake()) ++sum.asleep;
+            else sum.maxSpeedSquared = std::max(sum.maxSpeedSquared, velocity.squareMagnitude());
+            sum.minSize = std::min(sum.minSize, obj->getSize());
+
+            Species species = obj->getSpecies();
+            ++sum.count[species];
+            sum.kineticEnergy[species] += 0.5 * mass * velocity.squareMagnitude();
+            sum.momentumX += mass * velocity.x;
+            sum.momentumY += mass * velocity.y;
+
+            if (frame != nullptr) writer->record(frame, i, obj->getId(), part.getPosition(), velocity, species);
+        }, &site);
+
+        _binnedVersion = version;
+        if (substep < substeps) rebin(duration, substeps);
+        else _bins.clear();
+    }, &site);
+
+    for (std::size_t w = 1; w < workers; w++) sums[0].add(sums[w]);
+    counters.setParticles(complete ? std::accumulate(sums[0].count, sums[0].count + SPECIES_COUNT, std::size_t(0)) :
+                          _due.size());
+    if (frame != nullptr) writer->submit(frame, count);
+    ++steps;
+
+    std::lock_guard<std::mutex> uLock(_mutex);
+    if (complete) observables.update(sums[0], duration);
+    else observables.advance(sums[0], duration);
+}
 
-            Vector3 p1 = part1.getPosition();
-            double size1 = static_cast<double>(obj1->getSize());
+std::size_t PatrticlePhysics2D::strideLevel(double stableStep, double duration, std::size_t substeps) {
+    std::size_t level = 0;
+    while ((std::size_t(2) << level) <= substeps && static_cast<double>(std::size_t(2) << level) * duration <= stableStep) {
+        ++level;
+    }
+    return level;
+}
 
-            Vector3 p2 = part2.getPosition();
-            double size2 = static_cast<double>(obj2->getSize());
+void PatrticlePhysics2D::rebin(double duration, std::size_t substeps) {
+    _bins.assign(strideLevel(std::numeric_limits<double>::max(), duration, substeps) + 1, std::vector<uint32_t>());
+    _levels.resize(_stableSteps.size());
+    _binSlots.resize(_stableSteps.size());
+    for (uint32_t i = 0; i < _stableSteps.size(); i++) bin(i, strideLevel(_stableSteps[i], duration, substeps));
+}
 
-            Point l1 = {p1.x, p1.y};
-            Point r1 = {p1.x + size1, p1.y + size1};
+void PatrticlePhysics2D::bin(uint32_t i, std::size_t level) {
+    _levels[i] = static_cast<uint8_t>(level);
+    _binSlots[i] = static_cast<uint32_t>(_bins[level].size());
+    _bins[level].push_back(i);
+}
 
-            Point l2 = {p2.x, p2.y};
-            Point r2 = {p2.x + size2, p2.y + size2};
+void PatrticlePhysics2D::promote(uint32_t i) {
+    if (i >= _stableSteps.size()) return;
+    _stableSteps[i] = 0.0;
+    if (_bins.empty() || _levels[i] == 0) return;
+    // the last object of the bin takes its place
+    std::vector<uint32_t> &from = _bins[_levels[i]];
+    uint32_t last = from.back();
+    from[_binSlots[i]] = last;
+    _binSlots[last] = _binSlots[i];
+    from.pop_back();
+    bin(i, 0);
+}
+
+std::size_t PatrticlePhysics2D::detectCollisions() {
 
-            if (hasIntersection(l1, r1, l2, r2)) {
-                ++collisionCount;
-                resolveCollisions(obj1, obj2);
+    // the substeps of the integration thread detect collisions as well
+    std::lock_guard<std::mutex> colliderLock(_colliderMutex);
+
+    CollisionBudget budget;
+    budget.checks = config.getCollisionLimit();
+    if (config.getCollisionBudgetUs() > 0) {
+        budget.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(config.getCollisionBudgetUs());
+        budget.hasDeadline = true;
+    }
+
+    // Take a snapshot of all bounding boxes, so the broad phase can run without the lock.
+    // The shared pointers keep objects alive, which are removed in the meantime.
+    // Molecules which moved further than ccd_threshold times their size since the last
+    // pass get the box swept by this motion, so the broad phase finds what they passed.
+    static LockSite snapshotSite("PatrticlePhysics2D::detectCollisions snapshot");
+    uint64_t snapshotVersion = _particles.version(&snapshotSite);
+    double sweepThreshold = config.getCcdThreshold();
+    _particles.map([this, sweepThreshold](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+        _candidates.push_back(obj);
+        _ids.push_back(obj->getId());
+        Box box = getBox(*obj);
+        Vector3 position = obj->getParticle().getPosition();
+        Vector3 start;
+        bool swept = false;
+        if (sweepThreshold > 0.0 && obj->getPassPosition(start)) {
+            double limit = sweepThreshold * static_cast<double>(obj->getSize());
+            swept = (position - start).squareMagnitude() > limit * limit;
+        }
+        obj->setPassPosition(position);
+        _endBoxes.push_back(box);
+        _motion.push_back(swept ? position - start : Vector3());
+        _swept.push_back(swept);
+        _boxes.push_back(swept ? merge(translate(box, start - position), box) : box);
+        _speeds.push_back(obj->getParticle().getVelocity().squareMagnitude());
+        _awake.push_back(obj->getParticle().getAwake());
+        return false;
+    }, &snapshotSite);
+
+    {
+        ScopedTimer timer(phaseBroadphase);
+        CounterScope counters(phaseBroadphase, _boxes.size());
+        std::size_t fast = scheduleRows();
+        std::size_t done = _broadphase->findPairs(_boxes, _rows, budget, _pairs);
+        // continue the round robin after the last searched box, or start over in order
+        _overloaded = done < _rows.size();
+        _fastLimit = done / 2;
+        _cursor = _overloaded && done > fast ? _rows[done - 1] + 1 : (_overloaded ? _cursor : 0);
+        _searched.assign(_boxes.size(), 0);
+        for (std::size_t k = 0; k < done; k++) _searched[_rows[k]] = 1;
+    }
+
+    // The narrow phase checks the candidates again at their current position, because
+    // they may have moved or been resolved since the snapshot
+    std::size_t collisionCount = 0;
+    {
+        PhaseAccumulator narrowphase(phaseNarrowphase);
+        PhaseAccumulator resolve(phaseResolve);
+        TraceScope trace("narrowphase and resolve");
+        // the hardware counters are read once per pass, so they cover the resolution as well
+        CounterScope counters(phaseNarrowphase, _candidates.size());
+        static LockSite resolveSite("PatrticlePhysics2D::detectCollisions resolve");
+        _rewound.assign(_candidates.size(), 0);
+        _resolved.clear();
+        _contacts.beginPass();
+        _particles.synchronize([&]() {
+            // the indices of the pairs are those of the multi-rate bins, unless the list changed
+            uint64_t version = _particles.version(&resolveSite);
+            bool indexed = version == snapshotVersion;
+            for (const Pair &pair: _pairs) {
+                // a pair of two searched molecules is found from both sides, it is resolved once
+                if (pair.j < pair.i && _searched[pair.j]) continue;
+                std::shared_ptr<SimulationObject> &obj1 = _candidates[pair.i];
+                std::shared_ptr<SimulationObject> &obj2 = _candidates[pair.j];
+                narrowphase.start();
+                // a molecule moved back to a time of impact is only tested at its position
+                bool rewound = (_swept[pair.i] || _swept[pair.j]) && !_rewound[pair.i] && !_rewound[pair.j] &&
+                               rewindToImpact(pair.i, pair.j);
+                bool intersects = rewound || hasIntersection(getBox(*obj1), getBox(*obj2));
+                narrowphase.stop();
+                if (intersects) {
+                    // a contact of the last passes which separates already was resolved, another
+                    // displacement would only make it jitter
+                    Particle &part1 = obj1->getParticle();
+                    Particle &part2 = obj2->getParticle();
+                    bool persistent = _contacts.touch(pair.i, pair.j, _ids[pair.i], _ids[pair.j]);
+                    if (persistent && !rewound) {
+                        double half1 = 0.5 * static_cast<double>(obj1->getSize());
+                        double half2 = 0.5 * static_cast<double>(obj2->getSize());
+                        Vector3 centres = part2.getPosition() + Vector3(half2, half2, 0.0) - part1.getPosition() -
+                                          Vector3(half1, half1, 0.0);
+                        if ((part2.getVelocity() - part1.getVelocity()).scalarProduct(centres) > 0.0) continue;
+                    }
+                    // a contact with an awake molecule wakes a sleeping one up
+                    if (!part1.getAwake() && !part2.getAwake()) continue;
+                    if (!part1.getAwake()) part1.setAwake();
+                    if (!part2.getAwake()) part2.setAwake();
+                    resolve.start();
+                    ++collisionCount;
+                    _resolved.push_back(pair);
+                    // touching at the time of impact, they need no separation
+                    resolveCollisions(obj1, obj2, !rewound);
+                    if (indexed && version == _binnedVersion) {
+                        promote(pair.i);
+                        promote(pair.j);
+                    }
+                    resolve.stop();
+                }
             }
-            return false; // go on mapping list
-        });
-        return false; // go on mapping list
-    });
+            // without the indices the next integration rebins all objects
+            if (!indexed && !_resolved.empty()) _binnedVersion = std::numeric_limits<uint64_t>::max();
+        }, &resolveSite);
+        _contacts.endPass(_ids, _searched);
+    }
+
+    _candidates.clear();
+    _ids.clear();
+    _boxes.clear();
+    _speeds.clear();
+    _awake.clear();
+    _endBoxes.clear();
+    _motion.clear();
+    _swept.clear();
+
+    std::lock_guard<std::mutex> uLock(_mutex);
+    observables.collisionEnergyChange = collisionEnergyChange;
     return collisionCount;
 }
 
+bool PatrticlePhysics2D::rewindToImpact(uint32_t i, uint32_t j) {
+
+    Box start1 = translate(_endBoxes[i], _motion[i] * -1.0);
+    Box start2 = translate(_endBoxes[j], _motion[j] * -1.0);
+    double t = timeOfImpact(start1, _motion[i], start2, _motion[j]);
+    // no contact, or overlapping from the start, which the discrete test handles
+    if (t <= 0.0) return false;
+
+    Particle &part1 = _candidates[i]->getParticle();
+    Particle &part2 = _candidates[j]->getParticle();
+    Vector3 contact1 = Vector3(start1.l.x, start1.l.y, 0.0) + _motion[i] * t;
+    Vector3 contact2 = Vector3(start2.l.x, start2.l.y, 0.0) + _motion[j] * t;
+
+    // only approaching molecules collide, resolved ones move apart
+    double half1 = 0.5 * static_cast<double>(_candidates[i]->getSize());
+    double half2 = 0.5 * static_cast<double>(_candidates[j]->getSize());
+    Vector3 centres = contact2 + Vector3(half2, half2, 0.0) - contact1 - Vector3(half1, half1, 0.0);
+    if ((part2.getVelocity() - part1.getVelocity()).scalarProduct(centres) >= 0.0) return false;
+
+    // the motion after the impact is dropped
+    part1.setPosition(contact1);
+    part2.setPosition(contact2);
+    _rewound[i] = 1;
+    _rewound[j] = 1;
+    return true;
+}
+
+std::size_t PatrticlePhysics2D::scheduleRows() {
+
+    std::size_t n = _boxes.size();
+    _rows.clear();
+    if (_cursor >= n) _cursor = 0;
+
+    // Under overload the molecules faster than FAST_SPEED_FACTOR times the RMS speed come
+    // first, as they travel furthest between two checks. They take at most half of the
+    // rows of the last pass, so the round robin still advances.
+    _scheduled.assign(n, 0);
+    if (_overloaded && n > 0) {
+        double meanSquare = 0.0;
+        for (double speed: _speeds) meanSquare += speed;
+        double threshold = FAST_SPEED_FACTOR * FAST_SPEED_FACTOR * meanSquare / static_cast<double>(n);
+        for (std::size_t k = 0; k < n && _rows.size() < _fastLimit; k++) {
+            uint32_t i = static_cast<uint32_t>((_cursor + k) % n);
+            if (_awake[i] && _speeds[i] > threshold) {
+                _rows.push_back(i);
+                _scheduled[i] = 1;
+            }
+        }
+    }
+    std::size_t fast = _rows.size();
+
+    // round robin over all others, starting where the last pass stopped. Sleeping molecules
+    // are not searched, their contacts with awake molecules are found from the awake side.
+    for (std::size_t k = 0; k < n; k++) {
+        uint32_t i = static_cast<uint32_t>((_cursor + k) % n);
+        if (_awake[i] && !_scheduled[i]) _rows.push_back(i);
+    }
+    return fast;
+}
+
 void PatrticlePhysics2D::resolveCollisions(
         std::shared_ptr<SimulationObject> &obj1,
-        std::shared_ptr<SimulationObject> &obj2) {
+        std::shared_ptr<SimulationObject> &obj2,
+        bool separate) {
 
     Particle &part1 = obj1->getParticle();
     Particle &part2 = obj2->getParticle();
@@ -212,79 +593,31 @@ void PatrticlePhysics2D::resolveCollisions(
     Point r2 = {p2.x + size2, p2.y + size2};
 
     // Collision has occurred
-    Vector3 displacement = getDisplacement(l1, r1, l2, r2);
-    part1.setPosition(p1 + displacement);
-    part2.setPosition(p2 - displacement);
+    if (separate) {
+        Vector3 displacement = getDisplacement(l1, r1, l2, r2);
+        part1.setPosition(p1 + displacement);
+        part2.setPosition(p2 - displacement);
+    }
 
     Vector3 v1 = part1.getVelocity();
     double m1 = part1.getMass();
     Vector3 v2 = part2.getVelocity();
     double m2 = part2.getMass();
 
-    // FInd math in the following paper'
-    // https://imada.sdu.dk/~rolf/Edu/DM815/E10/2dcollisions.pdf
     Vector3 normal = (p2 - p1);
     double length = sqrt(normal.squareMagnitude());
-    Vector3 unitNormal = normal * (1.0f / length);
-    Vector3 unitTangent = Vector3(-unitNormal.y, unitNormal.x, 0.0f);
-
-    // Dot Product Tangent
-    double v1t = v1.scalarProduct(unitTangent);
-    if (isnan(v1t)) return;
-    double v2t = v2.scalarProduct(unitTangent);
-    if (isnan(v2t)) return;
-
-    // Dot Product Normal
-    double v1n = v1.scalarProduct(unitNormal);
-    if (isnan(v1n)) return;
-    double v2n = v2.scalarProduct(unitNormal);
-    if (isnan(v2n)) return;
-
-    double velocityRange = (double) config.getParticleVelocityRange();
-    double m1addm2 = m1 + m2;
-    double v1nNext = (v1n * (m1 - m2) + 2.0f * m2 * v2n) / m1addm2;
-    if (isnan(v1nNext)) return;
-    double v2nNext = (v2n * (m2 - m1) + 2.0f * m1 * v1n) / m1addm2;
-    if (isnan(v2nNext)) return;
-
-    // Update molecule velocities
-    Vector3 v1normalNext = unitNormal * v1nNext;
-    Vector3 v2normalNext = unitNormal * v2nNext;
-
-    Vector3 v1TangentialNext = unitTangent * v1t;
-    Vector3 v2TangentialNext = unitTangent * v2t;
-
-    Vector3 v1Next = v1normalNext + v1TangentialNext;
-    Vector3 v2Next = v2normalNext + v2TangentialNext;
+    Vector3 v1Next = v1, v2Next = v2;
+    if (!elasticCollision(v1Next, m1, v2Next, m2, normal * (1.0f / length))) return;
 
     part1.setVelocity(v1Next);
     part2.setVelocity(v2Next);
 
-}
+    // the new velocities may need a smaller step, integrate both in the next substep
+    obj1->setStableStep(0.0);
+    obj2->setStableStep(0.0);
 
-void PatrticlePhysics2D::changeEnergy(double factor) {
-    _particles.map([factor](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
-        if (obj->getSensitivity() == Sensitivity::sensitive) {
-            Particle &part = obj->getParticle();
-            Vector3 velocity = part.getVelocity();
-            part.setVelocity(velocity * factor);
-        }
-        return false;
-    });
-}
+    // an elastic collision keeps the kinetic energy, everything else is numerical error
+    collisionEnergyChange += 0.5 * m1 * (v1Next.squareMagnitude() - v1.squareMagnitude()) +
+                             0.5 * m2 * (v2Next.squareMagnitude() - v2.squareMagnitude());
 
-bool PatrticlePhysics2D::removeNonSensitiveObject() {
-    int pos = -1;
-    _particles.map([&](std::shared_ptr<SimulationObject> &obj, size_t i) mutable -> bool {
-        if (obj->getSensitivity() == Sensitivity::insensitive) {
-            pos = i;
-            return true;
-        }
-        return false;
-    });
-    if (pos >= 0) {
-        _particles.erase(pos);
-        return true;
-    }
-    return false;
-}
\ No newline at end of file
+}
@@ -5,74 +5,246 @@
 #ifndef COLLISIONSIM_PARTICLEPHYSICS2D_H
 #define COLLISIONSIM_PARTICLEPHYSICS2D_H
 
+#include <atomic>
+#include <limits>
 #include <thread>
-#include "simulationObject.h"
-#include "stoppable.h"
-#include "configuration.h"
+#include "physicsEngine.h"
+#include "broadphase.h"
+#include "contactManager.h"
+#include "interactions.h"
+#include "parallel.h"
 
 /**
- *
+ * Time stepped physics: the integration thread moves all objects by a time step, the
+ * collider thread detects and resolves the overlaps in between
  */
-class PatrticlePhysics2D : public Stoppable {
+class PatrticlePhysics2D : public PhysicsEngine {
 
 public:
 
     PatrticlePhysics2D(Configuration configuration,
                        SimulationObjects &particles) :
-            Stoppable(),
-            config(configuration),
+            PhysicsEngine(particles),
             collisions(0),
-            _particles(particles) {};
-
-    ~PatrticlePhysics2D();
+            steps(0),
+            workers(workerCount(configuration.getWorkerThreads())),
+            verlet(configuration.getIntegrator() == "verlet"),
+            collisionEnergyChange(0.0),
+            trajectory(nullptr),
+            _binnedVersion(std::numeric_limits<uint64_t>::max()),
+            _broadphase(createBroadphase(configuration.getBroadphase())),
+            _cursor(0),
+            _overloaded(false),
+            _fastLimit(0),
+            config(configuration) {
+        // a sleeping molecule would attract its neighbours without moving itself
+        setSleepEpsilon(configuration.getLjEpsilon() > 0.0 ? 0.0 : configuration.getSleepEpsilon());
+        if (configuration.getLjEpsilon() > 0.0) {
+            _interactions.reset(new LennardJones(configuration.getLjEpsilon(), configuration.getLjCutoff(),
+                                                 configuration.getLjSkin()));
+        }
+        if (!verlet && configuration.getIntegrator() != "euler") {
+            std::cerr << "Unknown integrator " << configuration.getIntegrator() << ", using euler.\n";
+        }
+        if (!_broadphase) {
+            std::cerr << "Unknown broadphase " << configuration.getBroadphase() << ", using bruteforce.\n";
+            _broadphase.reset(new BruteForceBroadphase());
+        }
+    };
+
+    ~PatrticlePhysics2D() override;
 
     /**
      * Run the integration (change in velocity over time, apply gravity force).
      * This method is intended to be used in its own thread
      */
-    void run();
+    void run() override;
 
     /**
     * Do the collision detection and resolvation
     * This method is intended to be used in its own thread
     */
-    void collider();
+    void collider() override;
 
     /**
-     * Accelerate simulation objects which marked as Sensitivity::sensitive
-     * @param factor multiply the actual velocity by the specified factor
+     * Integrates the duration, in stable substeps if timestep_cfl > 0, and resolves the
+     * collisions afterwards
      */
-    void changeEnergy(double factor);
+    void step(double duration) override;
 
     /**
-     * Return number of sensitive simulation objects
+     * Records every n'th integration step into the trajectory writer (nullptr disables recording)
      */
-    bool removeNonSensitiveObject();
+    void setTrajectoryWriter(TrajectoryWriter *writer) override { trajectory = writer; }
 
     /**
      * Returns the number of resolved detected and resolved collsions since last call.
      * Example: When called once per second, you get the #collisions/second
      */
-    std::size_t getCollisionsSincelastCall() {
+    std::size_t getCollisionsSincelastCall() override {
         std::lock_guard<std::mutex> uLock(_mutex);
         std::size_t result = collisions;
         collisions = 0;
         return result;
     }
 
-private:
+    /**
+     * Moves all objects by one time step and reflects them at the walls. With multi-rate
+     * stepping a physics tick consists of a power of two substeps: an object is only
+     * integrated at the substeps which are a multiple of its stride, the largest power of
+     * two substeps within its stable step, and at the end of the tick.
+     * @param duration duration of one substep
+     * @param substep number of the substep in the tick, 1..substeps
+     */
+    void integrate(double duration, std::size_t substep = 1, std::size_t substeps = 1);
 
-    std::mutex _mutex;
-    std::size_t collisions;
+    /**
+     * Finds and resolves the colliding objects. If the pass runs out of its budget
+     * (collision_budget_us, collision_limit), the next pass continues with the boxes which
+     * were not searched, after the fastest molecules, so every molecule is searched within
+     * a bounded number of passes.
+     * @return number of resolved collisions
+     */
+    std::size_t detectCollisions();
 
-    void integrate(double duration);
+    /**
+     * Returns the candidate pairs of the broad phase of the last collision pass, as indices
+     * into the list of objects at the start of the pass
+     */
+    const std::vector<Pair> &getPairs() const { return _pairs; }
 
-    std::size_t detectCollisions();
+    /**
+     * Returns the pairs resolved by the last collision pass, as indices into the list of
+     * objects at the start of the pass, in the order of resolution
+     */
+    const std::vector<Pair> &getResolvedPairs() const { return _resolved; }
+
+    /**
+     * Returns a copy of the contacts which began or ended in the last collision pass. It is
+     * taken under the collider lock, so it may be called while the collider thread runs.
+     */
+    std::vector<ContactEvent> takeContactEvents() {
+        std::lock_guard<std::mutex> colliderLock(_colliderMutex);
+        return _contacts.getEvents();
+    }
+
+    /**
+     * Returns the short range forces, nullptr without
+     */
+    LennardJones *getInteractions() { return _interactions.get(); }
+
+    /**
+     * Returns the thermodynamic state published by the last integration step
+     */
+    Observables getObservables() override {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        return observables;
+    }
+
+    /**
+     * Returns the number of integration steps since the start
+     */
+    std::size_t getSteps() override { return steps.load(); }
 
+    /**
+     * Separates two overlapping objects and exchanges their velocities by an elastic collision
+     * @param separate false for objects which touch but do not overlap
+     */
     void resolveCollisions(std::shared_ptr<SimulationObject> &obj1,
-                           std::shared_ptr<SimulationObject> &obj2);
+                           std::shared_ptr<SimulationObject> &obj2,
+                           bool separate = true);
+
+private:
+
+    /**
+     * Returns the largest time step in seconds in which no molecule moves further than
+     * timestep_cfl times the smallest molecule, according to the last integration
+     */
+    double stableTimestep();
+
+    /**
+     * Integrates the elapsed time in as many substeps as needed for a stable time step,
+     * with a collision pass after each but the last
+     */
+    void advance(double elapsed);
+
+    /**
+     * Continuous collision detection of a pair of candidates of which at least one swept
+     * its box. If they touched during their motion since the last pass and approach each
+     * other, both are moved back to where they touched first.
+     * @return true, if they were moved to the time of impact
+     */
+    bool rewindToImpact(uint32_t i, uint32_t j);
+
+    /**
+     * Fills the rows of the broad phase: the fast molecules first, if the last pass was
+     * overloaded, then all others round robin from the cursor
+     * @return the number of fast molecules
+     */
+    std::size_t scheduleRows();
+
+    /**
+     * Returns the power of two of the stride of an object in a multi-rate tick, i.e. of the
+     * largest number of substeps within its stable step which divides the tick
+     */
+    static std::size_t strideLevel(double stableStep, double duration, std::size_t substeps);
+
+    /**
+     * Sorts all objects into the bins of their stride by their last stable step
+     */
+    void rebin(double duration, std::size_t substeps);
+
+    void bin(uint32_t i, std::size_t level);
 
-    SimulationObjects &_particles;
+    /**
+     * Moves an object whose stable step a collision reset into the bin of the next substep
+     */
+    void promote(uint32_t i);
+
+    std::mutex _mutex;
+    std::mutex _colliderMutex;          // serializes the collision passes of both threads
+    std::size_t collisions;
+    std::atomic<std::size_t> steps;
+    std::size_t workers;
+    bool verlet;                        // velocity Verlet instead of Newton-Euler integration
+
+    // published under the mutex, gathered during the passes over the molecules
+    Observables observables;
+    double collisionEnergyChange;   // accumulated by resolveCollisions, serialised by _colliderMutex
+
+    TrajectoryWriter *trajectory;
+
+    std::unique_ptr<LennardJones> _interactions;    // nullptr without short range forces
+
+    // Multi-rate stepping: the objects binned by their stride, by index into the list of the
+    // version of the last pass over all objects. Changed under the lock of the list.
+    std::vector<double> _stableSteps;               // as of the last integration of each object
+    std::vector<std::vector<uint32_t>> _bins;       // by the power of two of the stride, empty between ticks
+    std::vector<uint8_t> _levels;                   // bin of each object
+    std::vector<uint32_t> _binSlots;                // position of each object in its bin
+    std::vector<uint32_t> _due;                     // in the current substep
+    uint64_t _binnedVersion;
+
+    // state of the collider thread, kept to reuse the allocated memory
+    std::unique_ptr<Broadphase> _broadphase;
+    std::vector<std::shared_ptr<SimulationObject>> _candidates;
+    std::vector<Box> _boxes;
+    std::vector<Pair> _pairs;
+    std::vector<Pair> _resolved;        // in this pass, to check that no pair is resolved twice
+    std::vector<double> _speeds;        // squared speed of the candidates
+    std::vector<uint8_t> _awake;
+    std::vector<Box> _endBoxes;         // box at the snapshot, the broad phase gets the swept one
+    std::vector<Vector3> _motion;       // since the last pass, if the box was swept
+    std::vector<uint8_t> _swept;
+    std::vector<uint8_t> _rewound;      // moved back to a time of impact in this pass
+    std::vector<uint64_t> _ids;
+    std::vector<uint8_t> _searched;     // the pairs of the candidate were searched in this pass
+    ContactManager _contacts;
+    std::vector<uint32_t> _rows;        // boxes to search the pairs for, in this order
+    std::vector<uint8_t> _scheduled;
+    std::size_t _cursor;                // first box of the round robin in the next pass
+    bool _overloaded;                   // the last pass ran out of budget
+    std::size_t _fastLimit;             // maximum number of fast molecules searched first
 
     Configuration config;
 
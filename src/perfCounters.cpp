@@ -0,0 +1,198 @@
+//
+// Created by Trebing, Peter on 2019-09-25.
+//
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "perfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+std::atomic<bool> PerfCounters::enabled(false);
+std::mutex PerfCounters::registryMutex;
+std::vector<std::unique_ptr<PerfCounters::ThreadCounters>> PerfCounters::registry;
+
+namespace {
+
+#ifdef __linux__
+
+const uint64_t COUNTER_CONFIGS[counterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/**
+ * Opens a counter of the calling thread, which is inherited by the threads it starts
+ * @return the file descriptor or -1
+ */
+int openCounter(uint64_t config) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.inherit = 1;
+    // user space only, allowed without privileges up to perf_event_paranoid=2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#endif
+
+}
+
+PerfCounters::ThreadCounters::~ThreadCounters() {
+#ifdef __linux__
+    for (int fd: fds) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+PerfCounters::ThreadCounters &PerfCounters::local() {
+    // every thread opens its counters once, they live as long as the process
+    thread_local ThreadCounters *counters = nullptr;
+    if (counters == nullptr) {
+        std::unique_ptr<ThreadCounters> created(new ThreadCounters());
+        for (auto &phase: created->values) {
+            for (auto &value: phase) value.store(0, std::memory_order_relaxed);
+        }
+        for (auto &particles: created->particleSteps) particles.store(0, std::memory_order_relaxed);
+        for (int &fd: created->fds) fd = -1;
+        created->available = false;
+#ifdef __linux__
+        created->available = true;
+        for (std::size_t c = 0; c < counterCount && created->available; c++) {
+            created->fds[c] = openCounter(COUNTER_CONFIGS[c]);
+            if (created->fds[c] < 0) {
+                int error = errno;
+                static std::once_flag warned;
+                std::call_once(warned, [error]() {
+                    // EACCES: restricted by /proc/sys/kernel/perf_event_paranoid,
+                    // ENOENT: no such hardware event, e.g. in a virtual machine
+                    std::cerr << "Hardware counters are not available: " << std::strerror(error) << ".\n";
+                });
+                created->available = false;
+            }
+        }
+#else
+        static std::once_flag warned;
+        std::call_once(warned, []() {
+            std::cerr << "Hardware counters are only supported on Linux.\n";
+        });
+#endif
+        counters = created.get();
+        std::lock_guard<std::mutex> uLock(registryMutex);
+        registry.push_back(std::move(created));
+    }
+    return *counters;
+}
+
+bool PerfCounters::read(uint64_t values[counterCount]) {
+    ThreadCounters &counters = local();
+    if (!counters.available) return false;
+#ifdef __linux__
+    for (std::size_t c = 0; c < counterCount; c++) {
+        // value, time enabled, time running
+        uint64_t data[3];
+        if (::read(counters.fds[c], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) return false;
+        // the kernel multiplexes the counters, if there are more than the hardware provides
+        values[c] = data[2] > 0 && data[2] < data[1] ?
+                    static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfCounters::record(Phase phase, const uint64_t values[counterCount], uint64_t particles) {
+    ThreadCounters &counters = local();
+    // only this thread writes, so a relaxed load and store is sufficient
+    for (std::size_t c = 0; c < counterCount; c++) {
+        std::atomic<uint64_t> &value = counters.values[phase][c];
+        value.store(value.load(std::memory_order_relaxed) + values[c], std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t> &particleSteps = counters.particleSteps[phase];
+    particleSteps.store(particleSteps.load(std::memory_order_relaxed) + particles, std::memory_order_relaxed);
+}
+
+CounterSnapshot PerfCounters::snapshot() {
+    CounterSnapshot result;
+    std::lock_guard<std::mutex> uLock(registryMutex);
+    for (auto &counters: registry) {
+        for (std::size_t p = 0; p < phaseCount; p++) {
+            for (std::size_t c = 0; c < counterCount; c++) {
+                result.values[p][c] += counters->values[p][c].load(std::memory_order_relaxed);
+            }
+            result.particleSteps[p] += counters->particleSteps[p].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+CounterSnapshot::CounterSnapshot() {
+    std::memset(values, 0, sizeof(values));
+    std::memset(particleSteps, 0, sizeof(particleSteps));
+}
+
+CounterSnapshot CounterSnapshot::operator-(const CounterSnapshot &earlier) const {
+    CounterSnapshot result;
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        for (std::size_t c = 0; c < counterCount; c++) {
+            result.values[p][c] = values[p][c] - earlier.values[p][c];
+        }
+        result.particleSteps[p] = particleSteps[p] - earlier.particleSteps[p];
+    }
+    return result;
+}
+
+double CounterSnapshot::ipc(Phase phase) const {
+    uint64_t cycles = values[phase][counterCycles];
+    return cycles > 0 ? static_cast<double>(values[phase][counterInstructions]) / static_cast<double>(cycles) : 0.0;
+}
+
+double CounterSnapshot::perParticle(Phase phase, Counter counter) const {
+    uint64_t particles = particleSteps[phase];
+    return particles > 0 ? static_cast<double>(values[phase][counter]) / static_cast<double>(particles) : 0.0;
+}
+
+std::string CounterSnapshot::summary() const {
+    std::ostringstream out;
+    out.precision(3);
+    bool first = true;
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        Phase phase = static_cast<Phase>(p);
+        if (values[phase][counterCycles] == 0) continue;
+        out << (first ? "" : " | ") << ProfileSnapshot::phaseName(phase) << " IPC " << ipc(phase)
+            << " cache-misses/particle " << perParticle(phase, counterCacheMisses)
+            << " branch-misses/particle " << perParticle(phase, counterBranchMisses);
+        first = false;
+    }
+    return first ? "no samples" : out.str();
+}
+
+const char *CounterSnapshot::counterName(Counter counter) {
+    switch (counter) {
+        case counterCycles:
+            return "cycles";
+        case counterInstructions:
+            return "instructions";
+        case counterCacheMisses:
+            return "cache_misses";
+        case counterBranchMisses:
+            return "branch_misses";
+        default:
+            return "unknown";
+    }
+}
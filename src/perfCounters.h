@@ -0,0 +1,150 @@
+//
+// Created by Trebing, Peter on 2019-09-25.
+//
+
+#ifndef COLLISIONSIM_PERFCOUNTERS_H
+#define COLLISIONSIM_PERFCOUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "profiler.h"
+
+/**
+ * The hardware events counted per phase
+ */
+enum Counter {
+    counterCycles,
+    counterInstructions,
+    counterCacheMisses,
+    counterBranchMisses,
+    counterCount
+};
+
+/**
+ * Summed up counter values of all threads. Like the profile, snapshots are cumulative and
+ * the difference of two snapshots describes the interval between them.
+ */
+class CounterSnapshot {
+
+public:
+
+    CounterSnapshot();
+
+    CounterSnapshot operator-(const CounterSnapshot &earlier) const;
+
+    uint64_t value(Phase phase, Counter counter) const { return values[phase][counter]; }
+
+    /**
+     * Number of particles processed by all recorded passes of a phase, i.e. particles times steps
+     */
+    uint64_t particles(Phase phase) const { return particleSteps[phase]; }
+
+    /**
+     * Instructions per cycle of a phase
+     */
+    double ipc(Phase phase) const;
+
+    /**
+     * Events of a counter per particle and step
+     */
+    double perParticle(Phase phase, Counter counter) const;
+
+    /**
+     * Returns a one line summary of IPC, cache and branch misses per particle of all counted phases
+     */
+    std::string summary() const;
+
+    static const char *counterName(Counter counter);
+
+private:
+    friend class PerfCounters;
+
+    uint64_t values[phaseCount][counterCount];
+    uint64_t particleSteps[phaseCount];
+};
+
+/**
+ * Reads the hardware performance counters of the calling thread with perf_event_open,
+ * on Linux only. The counters of a thread are opened on its first use and are inherited
+ * by the threads it starts, so the workers of a parallel pass are counted as well.
+ */
+class PerfCounters {
+
+public:
+
+    static void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Reads the counters of the calling thread, scaled up if the kernel had to multiplex them
+     * @return false, if the counters are not available
+     */
+    static bool read(uint64_t values[counterCount]);
+
+    /**
+     * Adds the counted events of a pass over a number of particles
+     */
+    static void record(Phase phase, const uint64_t values[counterCount], uint64_t particles);
+
+    /**
+     * Sums up the counters of all threads
+     */
+    static CounterSnapshot snapshot();
+
+private:
+
+    // Counters of a single thread, written by this thread only
+    struct ThreadCounters {
+        int fds[counterCount];
+        bool available;
+        std::atomic<uint64_t> values[phaseCount][counterCount];
+        std::atomic<uint64_t> particleSteps[phaseCount];
+
+        ~ThreadCounters();
+    };
+
+    static ThreadCounters &local();
+
+    static std::atomic<bool> enabled;
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<ThreadCounters>> registry;
+};
+
+/**
+ * Counts the hardware events between construction and destruction, if enabled
+ */
+class CounterScope {
+
+public:
+
+    CounterScope(Phase phase, std::size_t particles) :
+            phase(phase), particles(particles), active(PerfCounters::isEnabled()) {
+        if (active) active = PerfCounters::read(start);
+    }
+
+    /**
+     * Sets the number of particles, if it is only known at the end of the pass
+     */
+    void setParticles(std::size_t count) { particles = count; }
+
+    ~CounterScope() {
+        uint64_t end[counterCount];
+        if (active && PerfCounters::read(end)) {
+            for (std::size_t c = 0; c < counterCount; c++) end[c] -= start[c];
+            PerfCounters::record(phase, end, particles);
+        }
+    }
+
+private:
+    Phase phase;
+    std::size_t particles;
+    bool active;
+    uint64_t start[counterCount];
+};
+
+#endif //COLLISIONSIM_PERFCOUNTERS_H
@@ -0,0 +1,118 @@
+//
+// Created by Trebing, Peter on 2019-09-28.
+//
+
+#include "physicsEngine.h"
+#include "dsmcPhysics2D.h"
+#include "eventDrivenPhysics2D.h"
+#include "particlePhysics2D.h"
+
+void PhysicsEngine::addObject(std::shared_ptr<SimulationObject> object) {
+    bool insensitive = object->getSensitivity() == Sensitivity::insensitive;
+    SlotHandle handle = _particles.pushBack(std::move(object));
+    if (insensitive) {
+        std::lock_guard<std::mutex> uLock(_insensitiveMutex);
+        _insensitive.push_back(handle);
+    }
+}
+
+void PhysicsEngine::addObjects(std::vector<std::shared_ptr<SimulationObject>> &&objects) {
+    static LockSite site("PhysicsEngine::addObjects");
+    std::vector<uint8_t> insensitive(objects.size());
+    for (std::size_t k = 0; k < objects.size(); k++) {
+        insensitive[k] = objects[k]->getSensitivity() == Sensitivity::insensitive;
+    }
+    std::lock_guard<std::mutex> uLock(_insensitiveMutex);
+    _particles.synchronize([&]() {
+        std::size_t first = _particles.size(&site);
+        _particles.append(std::move(objects), &site);
+        for (std::size_t k = 0; k < insensitive.size(); k++) {
+            if (insensitive[k]) _insensitive.push_back(_particles.handle(first + k, &site));
+        }
+    }, &site);
+}
+
+void PhysicsEngine::changeEnergy(double factor) {
+    std::lock_guard<std::mutex> uLock(_energyMutex);
+    for (double &f: _energyFactors.factor) f *= factor;
+    _energyChanged = true;
+}
+
+void PhysicsEngine::changeEnergy(Species species, double factor) {
+    std::lock_guard<std::mutex> uLock(_energyMutex);
+    _energyFactors.factor[species] *= factor;
+    _energyChanged = true;
+}
+
+std::unique_ptr<CheckpointSnapshot> PhysicsEngine::snapshot(const std::string &configuration,
+                                                            const std::string &rngState) {
+    static LockSite site("PhysicsEngine::snapshot");
+    std::unique_ptr<CheckpointSnapshot> snapshot;
+    _particles.synchronize([&]() {
+        EnergyFactors pending;
+        {
+            std::lock_guard<std::mutex> uLock(_energyMutex);
+            pending = _energyFactors;
+        }
+        snapshot = Checkpoint::capture(_particles, configuration, rngState);
+        // the list is locked, so the objects come in the order of the capture
+        CheckpointSnapshot *s = snapshot.get();
+        _particles.map([s, &pending](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
+            if (i >= s->velocityX.size()) return true;
+            double f = pending.factor[obj->getSpecies()];
+            if (f != 1.0 && obj->getSensitivity() == Sensitivity::sensitive) {
+                s->velocityX[i] *= f;
+                s->velocityY[i] *= f;
+            }
+            return false;
+        }, &site);
+    }, &site);
+    return snapshot;
+}
+
+bool PhysicsEngine::takeEnergyFactors(EnergyFactors &factors) {
+    if (!_energyChanged.load()) return false;
+    std::lock_guard<std::mutex> uLock(_energyMutex);
+    factors = _energyFactors;
+    _energyFactors = EnergyFactors();
+    _energyChanged = false;
+    return true;
+}
+
+bool PhysicsEngine::removeNonSensitiveObject() {
+    static LockSite site("PhysicsEngine::removeNonSensitiveObject");
+    {
+        // the handles of removed objects turn invalid, they are dropped on the way
+        std::lock_guard<std::mutex> uLock(_insensitiveMutex);
+        while (!_insensitive.empty()) {
+            SlotHandle handle = _insensitive.back();
+            _insensitive.pop_back();
+            if (_particles.erase(handle, &site)) return true;
+        }
+    }
+
+    // objects added to the list directly are searched
+    int pos = -1;
+    _particles.map([&](std::shared_ptr<SimulationObject> &obj, size_t i) mutable -> bool {
+        if (obj->getSensitivity() == Sensitivity::insensitive) {
+            pos = i;
+            return true;
+        }
+        return false;
+    }, &site);
+    if (pos >= 0) {
+        _particles.erase(pos, &site);
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<PhysicsEngine> createPhysicsEngine(const std::string &name, Configuration configuration,
+                                                   SimulationObjects &particles) {
+    if (name == "time_step") return std::unique_ptr<PhysicsEngine>(new PatrticlePhysics2D(configuration, particles));
+    if (name == "event_driven") {
+        return std::unique_ptr<PhysicsEngine>(new EventDrivenPhysics2D(configuration, particles));
+    }
+    if (name == "dsmc") return std::unique_ptr<PhysicsEngine>(new DsmcPhysics2D(configuration, particles));
+    return nullptr;
+}
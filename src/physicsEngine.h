@@ -0,0 +1,157 @@
+//
+// Created by Trebing, Peter on 2019-09-28.
+//
+
+#ifndef COLLISIONSIM_PHYSICSENGINE_H
+#define COLLISIONSIM_PHYSICSENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+#include "configuration.h"
+#include "observables.h"
+#include "simulationObject.h"
+#include "stoppable.h"
+#include "trajectory.h"
+
+/**
+ * Velocity factors of changeEnergy per species, which the engines apply in their next pass
+ * over the molecules
+ */
+struct EnergyFactors {
+    double factor[SPECIES_COUNT];
+
+    EnergyFactors() { std::fill(factor, factor + SPECIES_COUNT, 1.0); }
+
+    /**
+     * Scales the velocity of a sensitive object by the factor of its species
+     * @return true, if the velocity changed
+     */
+    bool apply(SimulationObject &obj) const {
+        double f = factor[obj.getSpecies()];
+        if (f == 1.0 || obj.getSensitivity() != Sensitivity::sensitive) return false;
+        Particle &part = obj.getParticle();
+        part.setVelocity(part.getVelocity() * f);
+        return true;
+    }
+};
+
+/**
+ * Moves the simulation objects and resolves their collisions, either in threads of its own
+ * (run, collider) or step by step. The simulation and the benchmarks talk to the physics
+ * through this interface only, so the engines are selected at runtime by physics_engine
+ * and can be compared on the same scenario.
+ */
+class PhysicsEngine : public Stoppable {
+
+public:
+
+    explicit PhysicsEngine(SimulationObjects &particles) : Stoppable(), _particles(particles),
+                                                           _energyChanged(false) {}
+
+    virtual ~PhysicsEngine() = default;
+
+    /**
+     * Moves the objects until stopped. This method is intended to be used in its own thread
+     */
+    void run() override = 0;
+
+    /**
+     * Detects and resolves collisions until stopped, for engines which do this apart from
+     * the motion. This method is intended to be used in its own thread
+     */
+    virtual void collider() = 0;
+
+    /**
+     * Moves the objects by the given duration and resolves their collisions in the calling
+     * thread, which must not run run() or collider() at the same time
+     */
+    virtual void step(double duration) = 0;
+
+    /**
+     * Adds an object to the simulation
+     */
+    void addObject(std::shared_ptr<SimulationObject> object);
+
+    void addObjects(std::vector<std::shared_ptr<SimulationObject>> &&objects);
+
+    /**
+     * Accelerate simulation objects which marked as Sensitivity::sensitive. The factor is
+     * only recorded, the next step applies it, so the call does not depend on the number of
+     * objects.
+     * @param factor multiply the actual velocity by the specified factor
+     */
+    void changeEnergy(double factor);
+
+    /**
+     * Accelerate the sensitive objects of one species, see changeEnergy
+     */
+    void changeEnergy(Species species, double factor);
+
+    /**
+     * Removes an object which is marked as Sensitivity::insensitive, the last added one of
+     * those added through this engine, otherwise the first in the list
+     * @return false, if there is none
+     */
+    bool removeNonSensitiveObject();
+
+    /**
+     * Records every n'th step into the trajectory writer (nullptr disables recording)
+     */
+    virtual void setTrajectoryWriter(TrajectoryWriter *writer) = 0;
+
+    /**
+     * Returns the number of resolved collisions since the last call
+     */
+    virtual std::size_t getCollisionsSincelastCall() = 0;
+
+    /**
+     * Returns the thermodynamic state published by the last step
+     */
+    virtual Observables getObservables() = 0;
+
+    /**
+     * Returns the number of steps since the start
+     */
+    virtual std::size_t getSteps() = 0;
+
+    /**
+     * Captures the state of all objects for a checkpoint, with the factors of changeEnergy
+     * which no step applied yet
+     */
+    std::unique_ptr<CheckpointSnapshot> snapshot(const std::string &configuration, const std::string &rngState);
+
+protected:
+
+    /**
+     * Takes the factors of changeEnergy since the last call, for the pass which applies them.
+     * The pass must take them under the lock of the list, so a snapshot sees the factors
+     * either pending or applied.
+     * @return false, if there are none
+     */
+    bool takeEnergyFactors(EnergyFactors &factors);
+
+    SimulationObjects &_particles;
+
+private:
+
+    std::mutex _energyMutex;
+    EnergyFactors _energyFactors;           // not applied yet
+    std::atomic<bool> _energyChanged;
+
+    std::mutex _insensitiveMutex;
+    std::vector<SlotHandle> _insensitive;   // removal candidates, some may be removed already
+};
+
+/**
+ * Creates the engine of the given name: time_step (PatrticlePhysics2D), event_driven or dsmc
+ * @return nullptr for an unknown name
+ */
+std::unique_ptr<PhysicsEngine> createPhysicsEngine(const std::string &name, Configuration configuration,
+                                                   SimulationObjects &particles);
+
+#endif //COLLISIONSIM_PHYSICSENGINE_H
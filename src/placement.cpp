@@ -0,0 +1,121 @@
+//
+// Created by Trebing, Peter on 2019-09-22.
+//
+
+#include <iostream>
+#include <numeric>
+#include "molecules.h"
+#include "parallel.h"
+#include "placement.h"
+
+void initParticle(Configuration &config, Particle &part, double x, double y, Vector3 velocity) {
+    part.setPosition(x, y, 0.0);
+    part.setVelocity(velocity);
+    part.setAcceleration(Vector3(Vector3::GRAVITY) * -config.getGravityFactor());
+    part.setDamping(config.getDamping());
+}
+
+std::vector<std::shared_ptr<SimulationObject>> placeParticles(Configuration &config, int count,
+                                                              std::mt19937 &engine) {
+
+    int N2Count = (count * 78) / 100;
+    int O2Count = (count * 21) / 100;
+    int CO2Count = std::max((count / 100) * 1, 1);
+    std::cout << "N2Count = " << N2Count << std::endl;
+    std::cout << "O2Count = " << O2Count << std::endl;
+    std::cout << "CO2Count = " << CO2Count << std::endl;
+    std::size_t total = N2Count + O2Count + CO2Count;
+
+    // Jittered lattices per size class: the box is divided into square tiles, each tile
+    // holds molecules of one species on a lattice of their own size plus a gap of one
+    // pixel, with a random offset inside of their cell. So the small molecules are packed
+    // densely, no two molecules overlap and the species are spread over the whole box.
+    const Species order[SPECIES_COUNT] = {nitrogen, oxygen, carbonDioxide};
+    const std::size_t counts[SPECIES_COUNT] = {static_cast<std::size_t>(N2Count), static_cast<std::size_t>(O2Count),
+                                               static_cast<std::size_t>(CO2Count)};
+    std::size_t sizes[SPECIES_COUNT];
+    std::size_t largest = 0;
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        std::unique_ptr<Molecule> molecule(createMolecule(order[s]));
+        sizes[s] = molecule->getSize();
+        largest = std::max(largest, sizes[s] + 1);
+    }
+    std::size_t width = config.getWindowWidth();
+    std::size_t height = config.getWindowHeight();
+
+    // the smallest tile which fits the most molecules, small tiles mix the species best
+    std::size_t tileSize = 0, columns = 0, tiles = 0, overflow = total;
+    for (std::size_t t = largest; t <= std::min(width, height); t++) {
+        std::size_t available = (width / t) * (height / t);
+        std::size_t placed = 0;
+        for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+            std::size_t perTile = (t / (sizes[s] + 1)) * (t / (sizes[s] + 1));
+            std::size_t used = std::min((counts[s] + perTile - 1) / perTile, available);
+            placed += std::min(used * perTile, counts[s]);
+            available -= used;
+        }
+        if (total - placed < overflow) {
+            tileSize = t;
+            columns = width / t;
+            tiles = columns * (height / t);
+            overflow = total - placed;
+        }
+        if (overflow == 0) break;
+    }
+    if (overflow > 0) {
+        std::cerr << "Only " << total - overflow << " molecules fit into the box without overlap, "
+                  << overflow << " molecules are placed at random.\n";
+    }
+
+    // The tiles of a species follow each other, from the first tile of the species on
+    std::size_t perTile[SPECIES_COUNT], firstTile[SPECIES_COUNT];
+    std::size_t next = 0;
+    for (std::size_t s = 0; s < SPECIES_COUNT; s++) {
+        std::size_t columnsInTile = tileSize / (sizes[s] + 1);
+        perTile[s] = std::max<std::size_t>(columnsInTile * columnsInTile, 1);
+        firstTile[s] = next;
+        next += (counts[s] + perTile[s] - 1) / perTile[s];
+    }
+
+    // Tile t is placed at (t * stride + offset) mod tiles. With stride and tiles being
+    // coprime this is a permutation, i.e. the tiles are distinct and spread over the
+    // whole box without shuffling all tiles.
+    std::size_t stride = static_cast<std::size_t>(static_cast<double>(tiles) * 0.6180339887) + 1;
+    while (tiles > 0 && std::gcd(stride, tiles) != 1) ++stride;
+    std::size_t offset = tiles > 0 ? std::uniform_int_distribution<std::size_t>(0, tiles - 1)(engine) : 0;
+
+    // Every worker gets its own random engine, seeded from the simulation engine
+    std::size_t workers = workerCount(config.getWorkerThreads());
+    std::vector<std::mt19937::result_type> seeds(workers);
+    for (auto &seed: seeds) seed = engine();
+
+    std::vector<std::shared_ptr<SimulationObject>> molecules(total);
+    parallelFor(total, workers, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        std::mt19937 rng(seeds[worker]);
+        std::uniform_real_distribution<double> velocity(-config.getParticleVelocityRange(),
+                                                        config.getParticleVelocityRange());
+        for (std::size_t k = begin; k < end; k++) {
+            std::size_t s = k < counts[0] ? 0 : k < counts[0] + counts[1] ? 1 : 2;
+            std::size_t m = k - (s == 0 ? 0 : s == 1 ? counts[0] : counts[0] + counts[1]);
+            Molecule *molecule = createMolecule(order[s]);
+            int size = static_cast<int>(molecule->getSize());
+            std::size_t tile = firstTile[s] + m / perTile[s];
+            int x, y;
+            if (tile < tiles) {
+                std::size_t position = (tile * stride + offset) % tiles;
+                std::size_t columnsInTile = tileSize / (sizes[s] + 1);
+                std::size_t pitch = tileSize / columnsInTile;
+                std::size_t slot = m % perTile[s];
+                std::uniform_int_distribution<int> jitter(0, static_cast<int>(pitch) - size - 1);
+                x = static_cast<int>((position % columns) * tileSize + (slot % columnsInTile) * pitch) + jitter(rng);
+                y = static_cast<int>((position / columns) * tileSize + (slot / columnsInTile) * pitch) + jitter(rng);
+            } else {
+                x = std::uniform_int_distribution<int>(0, std::max(static_cast<int>(width) - size, 0))(rng);
+                y = std::uniform_int_distribution<int>(0, std::max(static_cast<int>(height) - size, 0))(rng);
+            }
+            initParticle(config, molecule->getParticle(), x, y, Vector3(velocity(rng), velocity(rng), 0.0));
+            molecules[k].reset(molecule);
+        }
+    });
+    return molecules;
+}
@@ -0,0 +1,29 @@
+//
+// Created by Trebing, Peter on 2019-09-22.
+//
+
+#ifndef COLLISIONSIM_PLACEMENT_H
+#define COLLISIONSIM_PLACEMENT_H
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "configuration.h"
+#include "simulationObject.h"
+
+/**
+ * Sets position and velocity of a particle, along with gravity and damping of the configuration
+ */
+void initParticle(Configuration &config, Particle &part, double x, double y, Vector3 velocity);
+
+/**
+ * Creates the molecules of the atmosphere (78% N2, 21% O2 and at least one CO2) and
+ * places them without overlap inside of the box, as long as they fit.
+ * @param config box size, velocity range and number of worker threads
+ * @param count number of molecules
+ * @param engine source of randomness, advanced by the placement
+ */
+std::vector<std::shared_ptr<SimulationObject>> placeParticles(Configuration &config, int count,
+                                                              std::mt19937 &engine);
+
+#endif //COLLISIONSIM_PLACEMENT_H
@@ -0,0 +1,146 @@
+//
+// Created by Trebing, Peter on 2019-09-18.
+//
+
+#include <cstring>
+#include <sstream>
+#include "profiler.h"
+
+std::atomic<bool> Profiler::enabled(true);
+std::mutex Profiler::registryMutex;
+std::vector<std::unique_ptr<Profiler::ThreadProfile>> Profiler::registry;
+
+std::size_t Profiler::bucket(uint64_t nanoseconds) {
+    if (nanoseconds < 8) return static_cast<std::size_t>(nanoseconds);
+    int msb = 63 - __builtin_clzll(nanoseconds);
+    std::size_t sub = static_cast<std::size_t>((nanoseconds >> (msb - 2)) & 3);
+    return 8 + static_cast<std::size_t>(msb - 3) * 4 + sub;
+}
+
+uint64_t Profiler::bucketLowerBound(std::size_t bucket) {
+    if (bucket < 8) return bucket;
+    int msb = static_cast<int>((bucket - 8) / 4) + 3;
+    uint64_t sub = (bucket - 8) % 4;
+    return (4 + sub) << (msb - 2);
+}
+
+Profiler::ThreadProfile &Profiler::local() {
+    // every thread registers its histograms once, they live as long as the process
+    thread_local ThreadProfile *profile = nullptr;
+    if (profile == nullptr) {
+        std::unique_ptr<ThreadProfile> created(new ThreadProfile());
+        for (auto &phase: created->counts) {
+            for (auto &count: phase) count.store(0, std::memory_order_relaxed);
+        }
+        for (auto &total: created->totalNs) total.store(0, std::memory_order_relaxed);
+        profile = created.get();
+        std::lock_guard<std::mutex> uLock(registryMutex);
+        registry.push_back(std::move(created));
+    }
+    return *profile;
+}
+
+void Profiler::record(Phase phase, uint64_t nanoseconds) {
+    ThreadProfile &profile = local();
+    // only this thread writes, so a relaxed load and store is sufficient
+    std::atomic<uint64_t> &count = profile.counts[phase][bucket(nanoseconds)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic<uint64_t> &total = profile.totalNs[phase];
+    total.store(total.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+}
+
+ProfileSnapshot Profiler::snapshot() {
+    ProfileSnapshot result;
+    std::lock_guard<std::mutex> uLock(registryMutex);
+    for (auto &profile: registry) {
+        for (std::size_t p = 0; p < phaseCount; p++) {
+            for (std::size_t b = 0; b < PROFILE_BUCKETS; b++) {
+                result.counts[p][b] += profile->counts[p][b].load(std::memory_order_relaxed);
+            }
+            result.totalNs[p] += profile->totalNs[p].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+ProfileSnapshot::ProfileSnapshot() {
+    std::memset(counts, 0, sizeof(counts));
+    std::memset(totalNs, 0, sizeof(totalNs));
+}
+
+ProfileSnapshot ProfileSnapshot::operator-(const ProfileSnapshot &earlier) const {
+    ProfileSnapshot result;
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        for (std::size_t b = 0; b < PROFILE_BUCKETS; b++) {
+            result.counts[p][b] = counts[p][b] - earlier.counts[p][b];
+        }
+        result.totalNs[p] = totalNs[p] - earlier.totalNs[p];
+    }
+    return result;
+}
+
+uint64_t ProfileSnapshot::count(Phase phase) const {
+    uint64_t result = 0;
+    for (uint64_t c: counts[phase]) result += c;
+    return result;
+}
+
+uint64_t ProfileSnapshot::percentile(Phase phase, double quantile) const {
+    uint64_t n = count(phase);
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(n - 1)) + 1;
+    uint64_t seen = 0;
+    for (std::size_t b = 0; b < PROFILE_BUCKETS; b++) {
+        seen += counts[phase][b];
+        if (seen >= rank) {
+            // report the middle of the bucket
+            if (b + 1 == PROFILE_BUCKETS) return Profiler::bucketLowerBound(b);
+            return (Profiler::bucketLowerBound(b) + Profiler::bucketLowerBound(b + 1)) / 2;
+        }
+    }
+    return Profiler::bucketLowerBound(PROFILE_BUCKETS - 1);
+}
+
+const char *ProfileSnapshot::phaseName(Phase phase) {
+    switch (phase) {
+        case phaseIntegrate:
+            return "integrate";
+        case phaseBroadphase:
+            return "broadphase";
+        case phaseNarrowphase:
+            return "narrowphase";
+        case phaseResolve:
+            return "resolve";
+        case phaseRender:
+            return "render";
+        case phaseLockWait:
+            return "lockwait";
+        default:
+            return "unknown";
+    }
+}
+
+std::string ProfileSnapshot::summary() const {
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed;
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        Phase phase = static_cast<Phase>(p);
+        out << (p == 0 ? "" : " | ") << phaseName(phase) << " n=" << count(phase)
+            << " p50=" << percentile(phase, 0.5) / 1000.0 << "us"
+            << " p99=" << percentile(phase, 0.99) / 1000.0 << "us";
+    }
+    return out.str();
+}
+
+std::string ProfileSnapshot::title() const {
+    static const char *shortNames[phaseCount] = {"int", "bp", "np", "res", "rnd", "lock"};
+    std::ostringstream out;
+    out << "p50/p99 us:";
+    for (std::size_t p = 0; p < phaseCount; p++) {
+        Phase phase = static_cast<Phase>(p);
+        out << ' ' << shortNames[p] << ' ' << percentile(phase, 0.5) / 1000 << '/'
+            << percentile(phase, 0.99) / 1000;
+    }
+    return out.str();
+}
@@ -0,0 +1,187 @@
+//
+// Created by Trebing, Peter on 2019-09-18.
+//
+
+#ifndef COLLISIONSIM_PROFILER_H
+#define COLLISIONSIM_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tracer.h"
+
+/**
+ * The phases of the simulation which are timed by the profiler
+ */
+enum Phase {
+    phaseIntegrate,
+    phaseBroadphase,
+    phaseNarrowphase,
+    phaseResolve,
+    phaseRender,
+    phaseLockWait,
+    phaseCount
+};
+
+/**
+ * Number of histogram buckets. Durations below 8ns get a bucket each, above that every
+ * power of two is split into 4 buckets, i.e. the relative error is below 25%.
+ */
+const std::size_t PROFILE_BUCKETS = 8 + 61 * 4;
+
+/**
+ * Merged histograms of all threads. Snapshots are cumulative, the difference of two
+ * snapshots describes the interval between them.
+ */
+class ProfileSnapshot {
+
+public:
+
+    ProfileSnapshot();
+
+    /**
+     * Returns the histograms of this snapshot minus the ones of an earlier snapshot
+     */
+    ProfileSnapshot operator-(const ProfileSnapshot &earlier) const;
+
+    /**
+     * Number of recorded durations of a phase
+     */
+    uint64_t count(Phase phase) const;
+
+    /**
+     * Sum of all recorded durations of a phase in nanoseconds
+     */
+    uint64_t total(Phase phase) const { return totalNs[phase]; }
+
+    /**
+     * Returns the approximated quantile (0..1) of a phase in nanoseconds
+     */
+    uint64_t percentile(Phase phase, double quantile) const;
+
+    /**
+     * Returns a one line summary with count, p50 and p99 of all phases
+     */
+    std::string summary() const;
+
+    /**
+     * Returns a compact p50/p99 summary to be shown in the window title
+     */
+    std::string title() const;
+
+    static const char *phaseName(Phase phase);
+
+private:
+    friend class Profiler;
+
+    uint64_t counts[phaseCount][PROFILE_BUCKETS];
+    uint64_t totalNs[phaseCount];
+};
+
+/**
+ * Collects duration histograms per phase. Every thread records into its own histograms,
+ * which are only read by snapshot, so recording never takes a lock.
+ */
+class Profiler {
+
+public:
+
+    static void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Adds a duration to the histogram of the calling thread
+     */
+    static void record(Phase phase, uint64_t nanoseconds);
+
+    /**
+     * Merges the histograms of all threads
+     */
+    static ProfileSnapshot snapshot();
+
+    static std::size_t bucket(uint64_t nanoseconds);
+
+    static uint64_t bucketLowerBound(std::size_t bucket);
+
+private:
+
+    // Histograms of a single thread, written by this thread only
+    struct ThreadProfile {
+        std::atomic<uint64_t> counts[phaseCount][PROFILE_BUCKETS];
+        std::atomic<uint64_t> totalNs[phaseCount];
+    };
+
+    static ThreadProfile &local();
+
+    static std::atomic<bool> enabled;
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<ThreadProfile>> registry;
+};
+
+/**
+ * Records the time between construction and destruction, into the profiler and, if
+ * enabled, as a span of the phase into the trace
+ */
+class ScopedTimer {
+
+public:
+
+    ScopedTimer(Phase phase) : phase(phase), active(Profiler::isEnabled()), tracing(Tracer::isEnabled()) {
+        if (active || tracing) start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedTimer() {
+        if (active || tracing) {
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            if (active) {
+                Profiler::record(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+            if (tracing) Tracer::record(ProfileSnapshot::phaseName(phase), start, end);
+        }
+    }
+
+private:
+    Phase phase;
+    bool active;
+    bool tracing;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Sums up the time of several start/stop intervals and records the sum on destruction,
+ * e.g. to time all narrow phase tests of one collision pass as a whole
+ */
+class PhaseAccumulator {
+
+public:
+
+    PhaseAccumulator(Phase phase) : phase(phase), active(Profiler::isEnabled()), sum(0) {}
+
+    ~PhaseAccumulator() {
+        if (active) Profiler::record(phase, sum);
+    }
+
+    void start() {
+        if (active) begin = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        if (active) {
+            sum += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - begin).count();
+        }
+    }
+
+private:
+    Phase phase;
+    bool active;
+    uint64_t sum;
+    std::chrono::steady_clock::time_point begin;
+};
+
+#endif //COLLISIONSIM_PROFILER_H
@@ -1,10 +1,20 @@
 #include "renderer.h"
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include "molecules.h"
+#include "profiler.h"
 
 Renderer::Renderer(Configuration configuration)
         : config(configuration) {
 
+    for (Species species: {nitrogen, oxygen, carbonDioxide}) {
+        std::unique_ptr<Molecule> molecule(createMolecule(species));
+        speciesColor.push_back(molecule->getColor());
+        speciesSize.push_back(static_cast<int>(molecule->getSize()));
+    }
+
     std::size_t numdrivers = SDL_GetNumRenderDrivers();
     std::cout << "Render driver count: " << numdrivers << std::endl;
     for (std::size_t i = 0; i < numdrivers; i++) {
@@ -60,6 +70,8 @@ Renderer::~Renderer() {
 
 void Renderer::render(SimulationObjects &particles) {
 
+    ScopedTimer timer(phaseRender);
+
     // Clear screen
     SDL_SetRenderDrawColor(sdl_renderer, 50, 204, 255, 0xFF);
     SDL_RenderClear(sdl_renderer);
@@ -67,6 +79,7 @@ void Renderer::render(SimulationObjects &particles) {
     std:
     size_t fraction = config.getParticleRenderLimit();
 
+    static LockSite site("Renderer::render");
     SDL_Renderer *renderer = sdl_renderer;
     particles.map([renderer, fraction](std::shared_ptr<SimulationObject> &obj, size_t i) -> bool {
         Particle &part = obj->getParticle();
@@ -84,14 +97,49 @@ void Renderer::render(SimulationObjects &particles) {
             SDL_RenderFillRect(renderer, &block);
         }
         return false;
-    });
+    }, &site);
+
+    // integrate Screen
+    SDL_RenderPresent(sdl_renderer);
+}
+
+void Renderer::render(const TrajectoryFrameView &frame) {
+
+    ScopedTimer timer(phaseRender);
+
+    // Clear screen
+    SDL_SetRenderDrawColor(sdl_renderer, 50, 204, 255, 0xFF);
+    SDL_RenderClear(sdl_renderer);
+
+    std::size_t fraction = config.getParticleRenderLimit();
+    int resolution = static_cast<int>(frame.resolution);
+    for (std::size_t i = fraction - 1; i < frame.count; i += fraction) {
+        uint8_t species = frame.species[i] < speciesSize.size() ? frame.species[i] : 0;
+        SDL_Rect block;
+        block.w = block.h = speciesSize[species];
+        block.x = frame.x[i] / resolution;
+        block.y = frame.y[i] / resolution;
+        RGBA color = speciesColor[species];
+        SDL_SetRenderDrawColor(sdl_renderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(sdl_renderer, &block);
+    }
 
     // integrate Screen
     SDL_RenderPresent(sdl_renderer);
 }
 
-void Renderer::UpdateWindowTitle(std::size_t particleCount, std::size_t fps, std::size_t collPerSec) {
+void Renderer::UpdateReplayTitle(const TrajectoryFrameView &frame, std::size_t frameCount, std::size_t fps,
+                                 double speed) {
+    std::ostringstream title;
+    title << " FPS: " << fps << " | Replay frame: " << frame.frame + 1 << "/" << frameCount << " | Step: "
+          << frame.step << " | Speed: " << speed << "x";
+    SDL_SetWindowTitle(sdl_window, title.str().c_str());
+}
+
+void Renderer::UpdateWindowTitle(std::size_t particleCount, std::size_t fps, std::size_t collPerSec,
+                                 const std::string &details) {
     std::string title{ " FPS: " + std::to_string(fps) + " | Molecules: " + std::to_string(particleCount)  + " | Collisions/sec: " +
                       std::to_string(collPerSec)};
+    if (!details.empty()) title += " | " + details;
     SDL_SetWindowTitle(sdl_window, title.c_str());
 }
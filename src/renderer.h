@@ -6,6 +6,7 @@
 #include "particle.h"
 #include "simulationObject.h"
 #include "configuration.h"
+#include "trajectoryPlayer.h"
 
 /**
  * SDL rendere interface for the simulator
@@ -19,9 +20,21 @@ public:
 
     void render(SimulationObjects &particles);
 
-    void UpdateWindowTitle(std::size_t score, std::size_t fps, std::size_t collPerSecond);
+    /**
+     * Renders a frame of a replayed trajectory
+     */
+    void render(const TrajectoryFrameView &frame);
+
+    void UpdateWindowTitle(std::size_t score, std::size_t fps, std::size_t collPerSecond,
+                           const std::string &details = "");
+
+    void UpdateReplayTitle(const TrajectoryFrameView &frame, std::size_t frameCount, std::size_t fps, double speed);
 
 private:
+    // color and size of each species, used to render replayed trajectories
+    std::vector<RGBA> speciesColor;
+    std::vector<int> speciesSize;
+
     SDL_Window *sdl_window;
     SDL_Renderer *sdl_renderer;
     Configuration config;
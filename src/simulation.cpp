@@ -2,14 +2,21 @@
 // Created by Trebing, Peter on 2019-08-27.
 //
 #include <iostream>
+#include <sstream>
 #include <future>
 #include <thread>
 #include "simulation.h"
 #include "SDL.h"
 #include "particle.h"
 #include "simulationObject.h"
-#include "particlePhysics2D.h"
+#include "physicsEngine.h"
 #include "molecules.h"
+#include "parallel.h"
+#include "placement.h"
+#include "lockProfiler.h"
+#include "perfCounters.h"
+#include "profiler.h"
+#include "tracer.h"
 
 Simulation::Simulation(Configuration configuration) :
         config(configuration),
@@ -18,7 +25,14 @@ Simulation::Simulation(Configuration configuration) :
         random_h(0, static_cast<int>(configuration.getWindowHeight())),
         random_v(-configuration.getParticleVelocityRange(), configuration.getParticleVelocityRange()),
         _simulatedObjects(SimulationObjects()),
-        physics2D(PatrticlePhysics2D(configuration, _simulatedObjects)) {
+        physics(createPhysicsEngine(configuration.getPhysicsEngine(), configuration, _simulatedObjects)),
+        checkpointWriter(configuration.getCheckpointFile()),
+        trajectoryWriter(configuration) {
+
+    if (!physics) {
+        std::cerr << "Unknown physics engine " << configuration.getPhysicsEngine() << ", using time_step.\n";
+        physics = createPhysicsEngine("time_step", configuration, _simulatedObjects);
+    }
 
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     std::default_random_engine engine(seed);
@@ -26,12 +40,17 @@ Simulation::Simulation(Configuration configuration) :
 }
 
 Simulation::~Simulation() {
-    physics2D.stop();
+    physics->stop();
+    checkpointWriter.stop();
+    trajectoryWriter.stop();
 
     // Wait for all threads to terminate
     for (auto &t: _threads) {
         t->join();
     }
+
+    // The trace ends with the final writes of checkpoint and trajectory
+    if (Tracer::isEnabled()) Tracer::write(config.getTraceFile());
 }
 
 void Simulation::Run(Controller &controller, Renderer &renderer,
@@ -40,21 +59,65 @@ void Simulation::Run(Controller &controller, Renderer &renderer,
     bool running = true;
     KeyState keys = KeyState{false, false, false};
 
-    // Create the items
-    PlaceParticles(config.getParticleCount());
+    // Tracing starts before the threads, so each of them is named in the trace
+    Tracer::setCapacity(config.getTraceBufferEvents());
+    Tracer::setEnabled(!config.getTraceFile().empty());
+    Tracer::setThreadName("main");
+
+    // Create the items, unless they have been restored from a checkpoint
+    if (_simulatedObjects.empty()) PlaceParticles(config.getParticleCount());
+
+    // Start the trajectory writer before the physics, so no step gets lost
+    if (trajectoryWriter.isEnabled()) {
+        physics->setTrajectoryWriter(&trajectoryWriter);
+        _threads.push_back(std::make_unique<std::thread>(std::thread([&]() {
+            Tracer::setThreadName("trajectory writer");
+            trajectoryWriter.run();
+        })));
+    }
 
     // Start a physics thread
-    _threads.push_back(std::make_unique<std::thread>(std::thread([&]() { physics2D.run(); })));
-    _threads.push_back(std::make_unique<std::thread>(std::thread([&]() { physics2D.collider(); })));
+    _threads.push_back(std::make_unique<std::thread>(std::thread([&]() {
+        Tracer::setThreadName("integrate");
+        physics->run();
+    })));
+    _threads.push_back(std::make_unique<std::thread>(std::thread([&]() {
+        Tracer::setThreadName("collider");
+        physics->collider();
+    })));
+
+    // Start the checkpoint writer
+    long checkpointInterval = static_cast<long>(config.getCheckpointIntervalS() * 1000);
+    if (checkpointInterval > 0) {
+        _threads.push_back(std::make_unique<std::thread>(std::thread([&]() {
+            Tracer::setThreadName("checkpoint writer");
+            checkpointWriter.run();
+        })));
+    }
 
     std::size_t frame_count = 0;
 
     std::chrono::time_point<std::chrono::system_clock> lastUpdate;
     std::chrono::time_point<std::chrono::system_clock> title_timestamp;
     std::chrono::time_point<std::chrono::system_clock> frame_end;
+    std::chrono::time_point<std::chrono::system_clock> checkpoint_timestamp;
+    std::chrono::time_point<std::chrono::system_clock> profile_timestamp;
+
+    // profiles at the last title and log update, to report the interval in between
+    Profiler::setEnabled(config.getProfiling());
+    ProfileSnapshot titleProfile = Profiler::snapshot();
+    ProfileSnapshot logProfile = titleProfile;
+    long profileLogInterval = static_cast<long>(config.getProfileLogIntervalS() * 1000);
+    LockProfiler::setEnabled(config.getLockProfiling());
+    std::vector<LockSiteStats> logLocks = LockProfiler::snapshot();
+    PerfCounters::setEnabled(config.getPerfCounters());
+    CounterSnapshot logCounters = PerfCounters::snapshot();
+    Observables titleObservables = physics->getObservables();
+    Observables logObservables = titleObservables;
+    double perimeter = 2.0 * static_cast<double>(config.getWindowWidth() + config.getWindowHeight());
 
     // init stop watch
-    lastUpdate = title_timestamp = std::chrono::system_clock::now();
+    lastUpdate = title_timestamp = checkpoint_timestamp = profile_timestamp = std::chrono::system_clock::now();
 
     while (running) {
 
@@ -69,17 +132,23 @@ void Simulation::Run(Controller &controller, Renderer &renderer,
         if (timeSinceLastUpdate >= target_frame_duration) {
 
             // Input, render - the main game loop.
-            controller.HandleInput(running, keys);
-            if (keys.heat) physics2D.changeEnergy(2.0f);
-            if (keys.cool) physics2D.changeEnergy(0.5f);
-            if (keys.plus) {
-                placeMolecule(new N2(), Vector3());
-                placeMolecule(new O2(), Vector3());
-            }
-            if (keys.minus && _simulatedObjects.size() > 1) {
-                physics2D.removeNonSensitiveObject();
-                physics2D.removeNonSensitiveObject();
+            {
+                TraceScope trace("input");
+                controller.HandleInput(running, keys);
+                if (keys.heat) physics->changeEnergy(2.0f);
+                if (keys.cool) physics->changeEnergy(0.5f);
+                if (keys.plus) {
+                    placeMolecule(new N2(), Vector3());
+                    placeMolecule(new O2(), Vector3());
+                }
+                static LockSite inputSite("Simulation::Run input");
+                if (keys.minus && _simulatedObjects.size(&inputSite) > 1) {
+                    physics->removeNonSensitiveObject();
+                    physics->removeNonSensitiveObject();
+                }
             }
+            // Write the trace on demand, the ring buffers keep recording
+            if (keys.trace && Tracer::isEnabled()) Tracer::write(config.getTraceFile());
 
             // Reset the pressed keys for next loop
             keys = KeyState{false, false, false};
@@ -94,12 +163,51 @@ void Simulation::Run(Controller &controller, Renderer &renderer,
             long timeSinceLastWindowsUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(
                     frame_end - title_timestamp).count();
             if (timeSinceLastWindowsUpdate >= 1000) {
-                renderer.UpdateWindowTitle(_simulatedObjects.size(), frame_count,
-                                           physics2D.getCollisionsSincelastCall());
+                ProfileSnapshot profile = Profiler::snapshot();
+                Observables observables = physics->getObservables();
+                std::string details = observables.title(titleObservables, perimeter);
+                if (config.getProfiling()) details += " | " + (profile - titleProfile).title();
+                static LockSite titleSite("Simulation::Run title");
+                renderer.UpdateWindowTitle(_simulatedObjects.size(&titleSite), frame_count,
+                                           physics->getCollisionsSincelastCall(), details);
+                titleProfile = profile;
+                titleObservables = observables;
                 frame_count = 0;
                 title_timestamp = frame_end;
             }
 
+            // Periodically log the observables and phase timings
+            if (profileLogInterval > 0 &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(frame_end - profile_timestamp).count() >=
+                profileLogInterval) {
+                Observables observables = physics->getObservables();
+                std::cout << "Observables: " << observables.summary(logObservables, perimeter) << std::endl;
+                logObservables = observables;
+                ProfileSnapshot profile = Profiler::snapshot();
+                if (config.getProfiling()) std::cout << "Profile: " << (profile - logProfile).summary() << std::endl;
+                logProfile = profile;
+                if (config.getLockProfiling()) {
+                    std::vector<LockSiteStats> locks = LockProfiler::snapshot();
+                    std::cout << "Locks:" << LockProfiler::report(LockProfiler::difference(locks, logLocks))
+                              << std::endl;
+                    logLocks = locks;
+                }
+                if (config.getPerfCounters()) {
+                    CounterSnapshot counters = PerfCounters::snapshot();
+                    std::cout << "Counters: " << (counters - logCounters).summary() << std::endl;
+                    logCounters = counters;
+                }
+                profile_timestamp = frame_end;
+            }
+
+            // Periodically hand a snapshot over to the checkpoint writer
+            if (checkpointInterval > 0 &&
+                std::chrono::duration_cast<std::chrono::milliseconds>(frame_end - checkpoint_timestamp).count() >=
+                checkpointInterval) {
+                submitCheckpoint();
+                checkpoint_timestamp = frame_end;
+            }
+
             // reset stop watch for next cycle
             lastUpdate = std::chrono::system_clock::now();
 
@@ -107,28 +215,53 @@ void Simulation::Run(Controller &controller, Renderer &renderer,
 
     }
 
-}
-
-void Simulation::PlaceParticles(int const count) {
+    // Write a final checkpoint, so the run can be resumed where it was left
+    if (checkpointInterval > 0) submitCheckpoint();
 
-    int N2Count = (count * 78) / 100;
-    int O2Count = (count * 21) / 100;
-    int CO2Count = std::max((count / 100) * 1, 1);
-    std::cout << "N2Count = " << N2Count << std::endl;
-    std::cout << "O2Count = " << O2Count << std::endl;
-    std::cout << "CO2Count = " << CO2Count << std::endl;
-    int i = 0;
-    while (i++ < N2Count) {
-        placeMolecule(new N2(), Vector3(random_v(engine), random_v(engine), 0.0));
-    }
-    i = 0;
-    while (i++ < O2Count) {
-        placeMolecule(new O2(), Vector3(random_v(engine), random_v(engine), 0.0));
+    if (config.getLockProfiling()) {
+        std::cout << "Locks (total):" << LockProfiler::report(LockProfiler::snapshot()) << std::endl;
     }
-    i = 0;
-    while (i++ < CO2Count) {
-        placeMolecule(new CO2(), Vector3(random_v(engine), random_v(engine), 0.0));
+    if (config.getPerfCounters()) {
+        std::cout << "Counters (total): " << PerfCounters::snapshot().summary() << std::endl;
     }
+
+}
+
+void Simulation::Restore(const Checkpoint &checkpoint) {
+
+    std::istringstream rngState(checkpoint.getRngState());
+    rngState >> engine;
+
+    const double *px = checkpoint.getPositionX();
+    const double *py = checkpoint.getPositionY();
+    const double *vx = checkpoint.getVelocityX();
+    const double *vy = checkpoint.getVelocityY();
+    const uint8_t *species = checkpoint.getSpecies();
+
+    // the molecules are created in parallel and handed over in one locked append
+    std::size_t count = checkpoint.getParticleCount();
+    std::vector<std::shared_ptr<SimulationObject>> molecules(count);
+    parallelFor(count, workerCount(config.getWorkerThreads()), [&](std::size_t begin, std::size_t end,
+                                                                     std::size_t worker) {
+        for (std::size_t i = begin; i < end; i++) {
+            Molecule *molecule = createMolecule(static_cast<Species>(species[i]));
+            ::initParticle(config, molecule->getParticle(), px[i], py[i], Vector3(vx[i], vy[i], 0.0));
+            molecules[i].reset(molecule);
+        }
+    });
+    physics->addObjects(std::move(molecules));
+    std::cout << "Restored " << checkpoint.getParticleCount() << " molecules from checkpoint" << std::endl;
+}
+
+void Simulation::submitCheckpoint() {
+    TraceScope trace("checkpoint capture");
+    std::ostringstream rngState;
+    rngState << engine;
+    checkpointWriter.submit(physics->snapshot(config.toString(), rngState.str()));
+}
+
+void Simulation::PlaceParticles(int const count) {
+    physics->addObjects(placeParticles(config, count, engine));
 }
 
 void Simulation::placeMolecule(Molecule *molecule, Vector3 velocity) {
@@ -138,13 +271,13 @@ void Simulation::placeMolecule(Molecule *molecule, Vector3 velocity) {
         y = random_h(engine);
         if (x >= 0 && x <= config.getWindowWidth() && y >= 0 && y <= config.getWindowHeight()) {
             std::unique_ptr<SimulationObject> m(molecule);
-            Particle &part = m->getParticle();
-            part.setPosition(x, y, 0.0);
-            part.setVelocity(velocity);
-            part.setAcceleration(Vector3(Vector3::GRAVITY) * -config.getGravityFactor());
-            part.setDamping(config.getDamping());
-            _simulatedObjects.pushBack(std::move(m));
+            initParticle(m->getParticle(), x, y, velocity);
+            physics->addObject(std::move(m));
             break;
         }
     }
 }
+
+void Simulation::initParticle(Particle &part, double x, double y, Vector3 velocity) {
+    ::initParticle(config, part, x, y, velocity);
+}
@@ -10,8 +10,10 @@
 #include "controller.h"
 #include "renderer.h"
 #include "particle.h"
-#include "particlePhysics2D.h"
+#include "physicsEngine.h"
 #include "configuration.h"
+#include "checkpoint.h"
+#include "trajectory.h"
 
 class Simulation {
 
@@ -24,12 +26,17 @@ public:
              Renderer &renderer,
              std::size_t target_frame_duration);
 
+    /**
+     * Replaces the initial placement of particles by the state stored in a checkpoint
+     */
+    void Restore(const Checkpoint &checkpoint);
+
 private:
 
     Configuration config;
 
-    PatrticlePhysics2D physics2D;
     SimulationObjects _simulatedObjects;
+    std::unique_ptr<PhysicsEngine> physics;
 
     std::random_device dev;
     std::mt19937 engine;
@@ -37,11 +44,18 @@ private:
     std::uniform_int_distribution<int> random_h;
     std::uniform_real_distribution<double> random_v;
 
+    CheckpointWriter checkpointWriter;
+    TrajectoryWriter trajectoryWriter;
+
     std::vector<std::unique_ptr<std::thread>> _threads;
 
     void PlaceParticles(int const count);
 
     void placeMolecule(Molecule *molecule, Vector3 velocity);
+
+    void initParticle(Particle &part, double x, double y, Vector3 velocity);
+
+    void submitCheckpoint();
 };
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #ifndef COLLISIONSIM_SIMULATIONOBJECT_H
 #define COLLISIONSIM_SIMULATIONOBJECT_H
 
+#include <atomic>
 #include <future>
 #include <thread>
 #include <vector>
@@ -29,6 +30,18 @@ enum Sensitivity {
     insensitive
 };
 
+/**
+ * The molecule species known to the simulation. The numeric values are persisted
+ * in checkpoints and must therefore not be reordered.
+ */
+enum Species {
+    nitrogen,
+    oxygen,
+    carbonDioxide
+};
+
+const std::size_t SPECIES_COUNT = 3;
+
 /**
  * SimulationObject ist an aggregation of Particle, which defines physical attributes
  * and the visual outline of the object
@@ -37,10 +50,16 @@ class SimulationObject {
 
 public:
 
-    SimulationObject() : part(Particle()), sensitivity(insensitive) {};
+    SimulationObject() : part(Particle()), sensitivity(insensitive), stableStep(0.0), lastSubstep(0),
+                         passPositionKnown(false), id(nextId()) {};
 
     virtual ~SimulationObject() {};
 
+    /**
+     * Returns the id of the object, unique within the process
+     */
+    uint64_t getId() const { return id; }
+
     /**
      * Returns the Particle instance of the obejct
      */
@@ -58,6 +77,11 @@ public:
      */
     virtual size_t getSize() = 0;
 
+    /**
+     * Returns the species of the object
+     */
+    virtual Species getSpecies() = 0;
+
     /**
      * Returns the sensitivity marker of the siumulation object. When it is sensitive,
      * the object shall be sensitive to user interaction, otherwise it follows only the
@@ -65,10 +89,52 @@ public:
      */
     Sensitivity getSensitivity() { return sensitivity; };
 
+    /**
+     * Returns the largest time step in which the object moves a stable distance, used by
+     * the multi-rate time stepping to integrate slow objects less often
+     */
+    double getStableStep() { return stableStep; }
+
+    void setStableStep(double step) { stableStep = step; }
+
+    /**
+     * Returns the substep of the current physics tick, at which the object was integrated last
+     */
+    std::size_t getLastSubstep() { return lastSubstep; }
+
+    void setLastSubstep(std::size_t substep) { lastSubstep = substep; }
+
+    /**
+     * Returns the position at the last collision pass, where the motion swept by the
+     * continuous collision detection starts
+     * @return false, if the object was not part of a collision pass yet
+     */
+    bool getPassPosition(Vector3 &position) {
+        position = passPosition;
+        return passPositionKnown;
+    }
+
+    void setPassPosition(const Vector3 &position) {
+        passPosition = position;
+        passPositionKnown = true;
+    }
+
 protected:
     Particle part;
     Sensitivity sensitivity;
+    double stableStep;
+    std::size_t lastSubstep;
+    Vector3 passPosition;
+    bool passPositionKnown;
+
+private:
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
 
+    uint64_t id;
 };
 
 typedef SynchronizedList<SimulationObject> SimulationObjects;
@@ -76,7 +142,8 @@ typedef SynchronizedList<SimulationObject> SimulationObjects;
 
 class Molecule : public SimulationObject {
 public:
-    Molecule(RGBA color, size_t size) : SimulationObject(), color(color), size(size) {};
+    Molecule(Species species, RGBA color, size_t size) :
+            SimulationObject(), species(species), color(color), size(size) {};
 
     ~Molecule() {};
 
@@ -84,7 +151,10 @@ public:
 
     size_t getSize() { return size; }
 
+    Species getSpecies() { return species; }
+
 private:
+    Species species;
     RGBA color;
     size_t size;
 
@@ -5,65 +5,300 @@
 #ifndef COLLISIONSIM_SYNCHRONIZEDLIST_H
 #define COLLISIONSIM_SYNCHRONIZEDLIST_H
 
+#include <cstdint>
 #include <future>
+#include <iterator>
+#include <limits>
 #include <thread>
 #include <vector>
+#include "lockProfiler.h"
+#include "parallel.h"
+#include "profiler.h"
 
+/**
+ * Stable reference to an item of a SynchronizedList. It stays valid while the item is in
+ * the list, whatever is added or removed meanwhile, and turns invalid once the item is
+ * removed, even if its slot is reused.
+ */
+struct SlotHandle {
+    uint32_t slot = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+};
+
+/**
+ * List of shared items under a lock. The items are stored densely, so map and parallelMap
+ * iterate over a plain vector by index. A slot map translates the handles into indices: an
+ * erase moves the last item into the gap (swap and pop), i.e. removes in constant time, but
+ * does not keep the order of the items.
+ */
 template<typename T>
 class SynchronizedList {
 
 public:
 
-    SynchronizedList() {}
+    SynchronizedList() : _version(0), _owner(std::thread::id()), _ownerSite(nullptr) {}
 
     ~SynchronizedList() {}
 
-    std::size_t size() {
-        std::lock_guard<std::recursive_mutex> uLock(_mutex);
+    std::size_t size(LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::size");
+        Guard uLock(*this, site ? site : &defaultSite);
         return _items.size();
     }
 
-    bool empty() {
-        std::lock_guard<std::recursive_mutex> myLock(_mutex);
+    /**
+     * Returns a number which changes whenever items are added or removed, so a caller can
+     * tell whether the indices it kept still refer to the same items
+     */
+    uint64_t version(LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::version");
+        Guard uLock(*this, site ? site : &defaultSite);
+        return _version;
+    }
+
+    bool empty(LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::empty");
+        Guard myLock(*this, site ? site : &defaultSite);
         return _items.empty();
     }
 
-    std::shared_ptr<T> popBack() {
+    std::shared_ptr<T> popBack(LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::popBack");
         // perform vector modification under the lock
-        std::lock_guard<std::recursive_mutex> uLock(_mutex);
+        Guard uLock(*this, site ? site : &defaultSite);
         // remove last vector keys from queue
         std::shared_ptr<T> v = std::move(_items.back());
-        _items.pop_back();
+        removeAt(_items.size() - 1);
         return v; // will not be copied due to return value optimization (RVO) in C++
     }
 
-    void pushBack(std::shared_ptr<T> &&v) {
+    SlotHandle pushBack(std::shared_ptr<T> &&v, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::pushBack");
         // perform vector modification under the lock
-        std::lock_guard<std::recursive_mutex> uLock(_mutex);
+        Guard uLock(*this, site ? site : &defaultSite);
         _items.emplace_back(std::move(v));
-
+        return acquireSlot();
     }
 
-    void erase(std::size_t pos) {
+    void append(std::vector<std::shared_ptr<T>> &&v, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::append");
         // perform vector modification under the lock
-        std::lock_guard<std::recursive_mutex> uLock(_mutex);
-        if (pos < _items.size() - 1) {
-            _items.erase(_items.begin() + pos);
+        Guard uLock(*this, site ? site : &defaultSite);
+        _items.reserve(_items.size() + v.size());
+        _slotOf.reserve(_items.size() + v.size());
+        for (auto &item: v) {
+            _items.emplace_back(std::move(item));
+            acquireSlot();
         }
+        v.clear();
+    }
+
+    /**
+     * Removes the item at the given index, the last item takes its place
+     * @return false, if there is none
+     */
+    bool erase(std::size_t pos, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::erase");
+        // perform vector modification under the lock
+        Guard uLock(*this, site ? site : &defaultSite);
+        if (pos >= _items.size()) return false;
+        removeAt(pos);
+        return true;
+    }
+
+    /**
+     * Removes the item of the handle, the last item takes its place
+     * @return false, if it was removed already
+     */
+    bool erase(SlotHandle handle, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::erase");
+        Guard uLock(*this, site ? site : &defaultSite);
+        if (!valid(handle)) return false;
+        removeAt(_slots[handle.slot].index);
+        return true;
+    }
+
+    /**
+     * Returns the item of the handle, nullptr if it was removed
+     */
+    std::shared_ptr<T> get(SlotHandle handle, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::get");
+        Guard uLock(*this, site ? site : &defaultSite);
+        return valid(handle) ? _items[_slots[handle.slot].index] : nullptr;
+    }
+
+    /**
+     * Returns the handle of the item at the given index, which must exist
+     */
+    SlotHandle handle(std::size_t pos, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::handle");
+        Guard uLock(*this, site ? site : &defaultSite);
+        uint32_t slot = _slotOf[pos];
+        return SlotHandle{slot, _slots[slot].generation};
     }
 
-    void map(const std::function<bool(std::shared_ptr<T> &part, size_t)> &f) {
+    void synchronize(const std::function<void()> &f, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::synchronize");
+        // perform operation under the lock
+        Guard uLock(*this, site ? site : &defaultSite);
+        f();
+    }
+
+    void map(const std::function<bool(std::shared_ptr<T> &part, size_t)> &f, LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::map");
         // perform lambda operation under the lock
-        std::lock_guard<std::recursive_mutex> uLock(_mutex);
+        Guard uLock(*this, site ? site : &defaultSite);
         size_t i = 0;
         for (auto &part: _items) {
             if (f(part, i++)) break;
         }
     }
 
+    /**
+     * Applies a function to all items under the lock, split into contiguous blocks which
+     * are processed by several threads. The function must not access the list itself.
+     * @param workers maximum number of threads
+     * @param grain minimum number of items per thread, smaller lists use less threads
+     * @param f function called with the item, its index and the number of the worker
+     */
+    void parallelMap(std::size_t workers, std::size_t grain,
+                     const std::function<void(std::shared_ptr<T> &part, size_t, size_t)> &f,
+                     LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::parallelMap");
+        Guard uLock(*this, site ? site : &defaultSite);
+        workers = std::max<std::size_t>(std::min(workers, _items.size() / std::max<std::size_t>(grain, 1)), 1);
+        parallelFor(_items.size(), workers, [this, &f](std::size_t begin, std::size_t end, std::size_t worker) {
+            for (std::size_t i = begin; i < end; i++) f(_items[i], i, worker);
+        });
+    }
+
+    /**
+     * Applies a function to the items at the given indices under the lock, see parallelMap
+     * @param indices of existing items, each at most once
+     */
+    void parallelMap(std::size_t workers, std::size_t grain, const std::vector<uint32_t> &indices,
+                     const std::function<void(std::shared_ptr<T> &part, size_t, size_t)> &f,
+                     LockSite *site = nullptr) {
+        static LockSite defaultSite("SynchronizedList::parallelMap");
+        Guard uLock(*this, site ? site : &defaultSite);
+        workers = std::max<std::size_t>(std::min(workers, indices.size() / std::max<std::size_t>(grain, 1)), 1);
+        parallelFor(indices.size(), workers, [this, &f, &indices](std::size_t begin, std::size_t end,
+                                                                  std::size_t worker) {
+            for (std::size_t k = begin; k < end; k++) f(_items[indices[k]], indices[k], worker);
+        });
+    }
+
 private:
+
+    struct Slot {
+        uint32_t index;         // of the item, if the slot is in use
+        uint32_t generation;    // counts the removals from the slot
+    };
+
+    bool valid(SlotHandle handle) const {
+        return handle.slot < _slots.size() && _slots[handle.slot].generation == handle.generation;
+    }
+
+    /**
+     * Assigns a slot to the last item, reusing a free one if possible
+     */
+    SlotHandle acquireSlot() {
+        uint32_t slot;
+        if (!_freeSlots.empty()) {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(_slots.size());
+            _slots.push_back(Slot{0, 1});
+        }
+        _slots[slot].index = static_cast<uint32_t>(_items.size() - 1);
+        _slotOf.push_back(slot);
+        ++_version;
+        return SlotHandle{slot, _slots[slot].generation};
+    }
+
+    void removeAt(std::size_t pos) {
+        ++_version;
+        uint32_t slot = _slotOf[pos];
+        ++_slots[slot].generation;
+        _freeSlots.push_back(slot);
+        std::size_t last = _items.size() - 1;
+        if (pos != last) {
+            _items[pos] = std::move(_items[last]);
+            _slotOf[pos] = _slotOf[last];
+            _slots[_slotOf[pos]].index = static_cast<uint32_t>(pos);
+        }
+        _items.pop_back();
+        _slotOf.pop_back();
+    }
+
+    /**
+     * Lock guard which records the contention of the outermost acquisition per call site.
+     * Recursive acquisitions by the owning thread are not recorded, they never wait.
+     */
+    class Guard {
+
+    public:
+
+        Guard(SynchronizedList &list, LockSite *site) : list(list), site(site), outermost(false) {
+            if (list._owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                list._mutex.lock();
+                return;
+            }
+            outermost = true;
+            bool contended = !list._mutex.try_lock();
+            uint64_t waited = 0;
+            if (contended) {
+                // charge the wait to the site holding the lock at this moment
+                LockSite *holder = list._ownerSite.load(std::memory_order_relaxed);
+                auto start = std::chrono::steady_clock::now();
+                list._mutex.lock();
+                auto end = std::chrono::steady_clock::now();
+                waited = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                if (Tracer::isEnabled()) Tracer::record("lock wait", start, end);
+                if (holder != nullptr) holder->addBlocked(waited);
+            }
+            if (Profiler::isEnabled()) Profiler::record(phaseLockWait, waited);
+            list._owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            list._ownerSite.store(site, std::memory_order_relaxed);
+            profiling = LockProfiler::isEnabled();
+            if (profiling) {
+                this->waited = waited;
+                this->contended = contended;
+                acquired = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Guard() {
+            if (outermost) {
+                if (profiling) {
+                    site->record(waited, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - acquired).count(), contended);
+                }
+                list._ownerSite.store(nullptr, std::memory_order_relaxed);
+                list._owner.store(std::thread::id(), std::memory_order_relaxed);
+            }
+            list._mutex.unlock();
+        }
+
+    private:
+        SynchronizedList &list;
+        LockSite *site;
+        bool outermost;
+        bool profiling;
+        bool contended;
+        uint64_t waited;
+        std::chrono::steady_clock::time_point acquired;
+    };
+
     std::vector<std::shared_ptr<T>> _items; // list of all items in the simulationn
+    std::vector<uint32_t> _slotOf;          // slot of each item
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _freeSlots;
+    uint64_t _version;                      // counts the additions and removals
     std::recursive_mutex _mutex;
+    std::atomic<std::thread::id> _owner;        // thread holding the lock
+    std::atomic<LockSite *> _ownerSite;         // call site holding the lock
 
 };
 
@@ -0,0 +1,102 @@
+//
+// Created by Trebing, Peter on 2019-09-20.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "tracer.h"
+
+std::atomic<bool> Tracer::enabled(false);
+std::atomic<std::size_t> Tracer::capacity(65536);
+const std::chrono::steady_clock::time_point Tracer::epoch = std::chrono::steady_clock::now();
+std::mutex Tracer::registryMutex;
+std::vector<std::unique_ptr<Tracer::ThreadTrace>> Tracer::registry;
+
+namespace {
+
+// name of the calling thread, until its ring buffer is allocated
+thread_local const char *threadName = nullptr;
+
+}
+
+Tracer::ThreadTrace *Tracer::local(bool allocate) {
+    // every thread registers its ring buffer once, it lives as long as the process
+    thread_local ThreadTrace *trace = nullptr;
+    if (trace == nullptr && allocate) {
+        std::unique_ptr<ThreadTrace> created(new ThreadTrace());
+        created->name = threadName;
+        created->events.resize(std::max<std::size_t>(capacity.load(std::memory_order_relaxed), 1));
+        created->recorded = 0;
+        trace = created.get();
+        std::lock_guard<std::mutex> uLock(registryMutex);
+        created->id = registry.size() + 1;
+        registry.push_back(std::move(created));
+    }
+    return trace;
+}
+
+void Tracer::setThreadName(const char *name) {
+    // the ring buffer is allocated with the first event, so threads which never record cost nothing
+    threadName = name;
+    ThreadTrace *trace = local(false);
+    if (trace == nullptr) return;
+    std::lock_guard<std::mutex> uLock(trace->mutex);
+    trace->name = name;
+}
+
+void Tracer::record(const char *name, std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end) {
+    ThreadTrace &trace = *local(true);
+    TraceEvent event{name,
+                     static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             begin - epoch).count()),
+                     static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             end - begin).count())};
+    std::lock_guard<std::mutex> uLock(trace.mutex);
+    trace.events[trace.recorded % trace.events.size()] = event;
+    ++trace.recorded;
+}
+
+bool Tracer::write(const std::string &filename) {
+
+    std::ofstream out(filename, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Couldn't open " << filename << " for writing.\n";
+        return false;
+    }
+
+    // timestamps are given in microseconds, keep the nanoseconds as fraction
+    out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::size_t count = 0;
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    for (auto &trace: registry) {
+        std::lock_guard<std::mutex> uLock(trace->mutex);
+        if (trace->name != nullptr) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->id
+                << ",\"args\":{\"name\":\"" << trace->name << "\"}}";
+            first = false;
+        }
+        // oldest event first, the ring buffer may have wrapped
+        std::size_t size = trace->events.size();
+        uint64_t begin = trace->recorded > size ? trace->recorded - size : 0;
+        for (uint64_t i = begin; i < trace->recorded; i++) {
+            const TraceEvent &event = trace->events[i % size];
+            out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << trace->id << ",\"ts\":" << event.beginNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0
+                << "}";
+            first = false;
+            ++count;
+        }
+    }
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        std::cerr << "Couldn't write " << filename << ".\n";
+        return false;
+    }
+    std::cout << "Wrote " << count << " trace events to " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,108 @@
+//
+// Created by Trebing, Peter on 2019-09-20.
+//
+
+#ifndef COLLISIONSIM_TRACER_H
+#define COLLISIONSIM_TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A complete event, i.e. a named span of time on one thread.
+ * Names must be string literals, they are neither copied nor escaped.
+ */
+struct TraceEvent {
+    const char *name;
+    uint64_t beginNs;       // since the start of the process
+    uint64_t durationNs;
+};
+
+/**
+ * Records spans of the simulation threads into per thread ring buffers and writes them
+ * in the Chrome Trace Event format, which can be opened with chrome://tracing or Perfetto.
+ * When a ring buffer is full the oldest events are overwritten, so a trace always shows
+ * the most recent part of the run.
+ */
+class Tracer {
+
+public:
+
+    static void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Sets the number of events per thread, applies to threads which record their first event afterwards
+     */
+    static void setCapacity(std::size_t events) { capacity.store(events, std::memory_order_relaxed); }
+
+    /**
+     * Names the calling thread in the trace, without allocating its ring buffer
+     */
+    static void setThreadName(const char *name);
+
+    /**
+     * Adds a span to the ring buffer of the calling thread
+     */
+    static void record(const char *name, std::chrono::steady_clock::time_point begin,
+                       std::chrono::steady_clock::time_point end);
+
+    /**
+     * Writes the events of all threads as Chrome Trace Event JSON
+     * @return false, if the file could not be written
+     */
+    static bool write(const std::string &filename);
+
+private:
+
+    // Ring buffer of a single thread, the mutex is only contended while the trace is written
+    struct ThreadTrace {
+        std::mutex mutex;
+        const char *name;
+        std::size_t id;
+        std::vector<TraceEvent> events;
+        uint64_t recorded;
+    };
+
+    /**
+     * Returns the ring buffer of the calling thread
+     * @param allocate whether to allocate it, if the thread has not recorded any event yet
+     * @return nullptr, if it has not been allocated
+     */
+    static ThreadTrace *local(bool allocate);
+
+    static std::atomic<bool> enabled;
+    static std::atomic<std::size_t> capacity;
+    static const std::chrono::steady_clock::time_point epoch;
+    static std::mutex registryMutex;
+    static std::vector<std::unique_ptr<ThreadTrace>> registry;
+};
+
+/**
+ * Traces the time between construction and destruction
+ */
+class TraceScope {
+
+public:
+
+    TraceScope(const char *name) : name(name), active(Tracer::isEnabled()) {
+        if (active) begin = std::chrono::steady_clock::now();
+    }
+
+    ~TraceScope() {
+        if (active) Tracer::record(name, begin, std::chrono::steady_clock::now());
+    }
+
+private:
+    const char *name;
+    bool active;
+    std::chrono::steady_clock::time_point begin;
+};
+
+#endif //COLLISIONSIM_TRACER_H
@@ -0,0 +1,210 @@
+//
+// Created by Trebing, Peter on 2019-09-15.
+//
+
+#include <cstring>
+#include <thread>
+#include "trajectory.h"
+#include "tracer.h"
+
+const uint32_t TrajectoryWriter::VERSION = 1;
+
+namespace {
+
+/**
+ * Appends a delta modulo 2^32 as zig-zag encoded varint, i.e. small positive and negative
+ * deltas only need a single byte
+ */
+void appendVarint(std::vector<uint8_t> &buffer, uint32_t delta) {
+    uint32_t zigzag = (delta << 1) ^ (0u - (delta >> 31));
+    while (zigzag >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(zigzag));
+}
+
+void writeRaw(std::ofstream &out, const void *data, std::size_t size) {
+    out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+}
+
+}
+
+TrajectoryWriter::TrajectoryWriter(Configuration configuration) :
+        Stoppable(),
+        filename(configuration.getTrajectoryFile()),
+        width(static_cast<uint32_t>(configuration.getWindowWidth())),
+        height(static_cast<uint32_t>(configuration.getWindowHeight())),
+        resolution(static_cast<uint32_t>(std::max<std::size_t>(configuration.getTrajectoryResolution(), 1))),
+        stride(static_cast<uint32_t>(std::max<std::size_t>(configuration.getTrajectoryStride(), 1))),
+        chunkFrames(std::max<std::size_t>(configuration.getTrajectoryChunkFrames(), 1)),
+        dropped(0),
+        frameCount(0) {
+
+    // all frame buffers are allocated once, they are recycled afterwards
+    std::size_t bufferFrames = std::max<std::size_t>(configuration.getTrajectoryBufferFrames(), 1);
+    for (std::size_t i = 0; i < bufferFrames; i++) {
+        frames.push_back(std::make_unique<TrajectoryFrame>());
+        resize(frames.back().get(), configuration.getParticleCount());
+        freeFrames.push_back(frames.back().get());
+    }
+}
+
+void TrajectoryWriter::resize(TrajectoryFrame *frame, std::size_t count) {
+    for (auto &column: frame->column) column.resize(count);
+    frame->species.resize(count);
+    frame->id.resize(count);
+    frame->count = count;
+}
+
+TrajectoryFrame *TrajectoryWriter::acquire(uint64_t step) {
+    if (step % stride != 0) return nullptr;
+    std::lock_guard<std::mutex> uLock(_mutex);
+    if (freeFrames.empty()) {
+        ++dropped;
+        return nullptr;
+    }
+    TrajectoryFrame *frame = freeFrames.back();
+    freeFrames.pop_back();
+    frame->step = step;
+    return frame;
+}
+
+void TrajectoryWriter::submit(TrajectoryFrame *frame, std::size_t count) {
+    // the buffers keep their capacity, only the logical size changes
+    if (count != frame->count) resize(frame, count);
+    std::lock_guard<std::mutex> uLock(_mutex);
+    recordedFrames.push_back(frame);
+}
+
+void TrajectoryWriter::run() {
+
+    if (!open()) return;
+
+    bool stopping = false;
+    while (true) {
+        TrajectoryFrame *frame = nullptr;
+        {
+            std::lock_guard<std::mutex> uLock(_mutex);
+            if (!recordedFrames.empty()) {
+                frame = recordedFrames.front();
+                recordedFrames.pop_front();
+            }
+        }
+        if (frame == nullptr) {
+            // write the remaining frames before terminating
+            if (stopping) break;
+            stopping = stopRequested();
+            if (!stopping) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        encode(*frame);
+
+        std::lock_guard<std::mutex> uLock(_mutex);
+        freeFrames.push_back(frame);
+    }
+
+    close();
+}
+
+bool TrajectoryWriter::open() {
+    out.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Couldn't open " << filename << " for writing.\n";
+        return false;
+    }
+    TrajectoryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CSIMTRAJ", sizeof(header.magic));
+    header.version = VERSION;
+    header.byteOrder = 0x01020304;
+    header.width = width;
+    header.height = height;
+    header.resolution = resolution;
+    header.stride = stride;
+    writeRaw(out, &header, sizeof(header));
+    return true;
+}
+
+void TrajectoryWriter::encode(const TrajectoryFrame &frame) {
+
+    TraceScope trace("trajectory encode");
+
+    // a chunk only holds frames of the very same particles, a removal moves another one to
+    // the index of the removed particle
+    bool sameParticles = frame.count == chunkIds.size() &&
+                         std::equal(chunkIds.begin(), chunkIds.end(), frame.id.begin());
+    if (!chunkSteps.empty() && (!sameParticles || chunkSteps.size() >= chunkFrames)) {
+        flushChunk();
+    }
+    if (chunkSteps.empty()) {
+        chunkSpecies.assign(frame.species.begin(), frame.species.begin() + frame.count);
+        chunkIds.assign(frame.id.begin(), frame.id.begin() + frame.count);
+        for (auto &column: previous) column.assign(frame.count, 0);
+    }
+
+    chunkSteps.push_back(frame.step);
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; c++) {
+        std::vector<uint8_t> &buffer = chunkColumn[c];
+        std::vector<int32_t> &last = previous[c];
+        const int32_t *values = frame.column[c].data();
+        for (std::size_t i = 0; i < frame.count; i++) {
+            appendVarint(buffer, static_cast<uint32_t>(values[i]) - static_cast<uint32_t>(last[i]));
+            last[i] = values[i];
+        }
+    }
+}
+
+void TrajectoryWriter::flushChunk() {
+
+    if (chunkSteps.empty()) return;
+
+    TraceScope trace("trajectory flush");
+
+    TrajectoryChunkHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CHNK", sizeof(header.magic));
+    header.frameCount = static_cast<uint32_t>(chunkSteps.size());
+    header.particleCount = static_cast<uint32_t>(chunkSpecies.size());
+    header.firstFrame = frameCount;
+    for (uint32_t c = 0; c < TRAJECTORY_COLUMNS; c++) {
+        header.columnSize[c] = chunkColumn[c].size();
+    }
+
+    TrajectoryIndexEntry entry;
+    entry.offset = static_cast<uint64_t>(out.tellp());
+    entry.firstFrame = header.firstFrame;
+    entry.frameCount = header.frameCount;
+    entry.particleCount = header.particleCount;
+    index.push_back(entry);
+
+    const uint64_t padding = 0;
+    writeRaw(out, &header, sizeof(header));
+    writeRaw(out, chunkSpecies.data(), chunkSpecies.size());
+    writeRaw(out, &padding, (8 - chunkSpecies.size() % 8) % 8);
+    writeRaw(out, chunkSteps.data(), chunkSteps.size() * sizeof(uint64_t));
+    for (auto &column: chunkColumn) {
+        writeRaw(out, column.data(), column.size());
+        column.clear();
+    }
+
+    frameCount += chunkSteps.size();
+    chunkSteps.clear();
+}
+
+void TrajectoryWriter::close() {
+
+    flushChunk();
+
+    TrajectoryTrailer trailer;
+    trailer.indexOffset = static_cast<uint64_t>(out.tellp());
+    trailer.chunkCount = index.size();
+    std::memcpy(trailer.magic, "CSIMTIDX", sizeof(trailer.magic));
+    writeRaw(out, index.data(), index.size() * sizeof(TrajectoryIndexEntry));
+    writeRaw(out, &trailer, sizeof(trailer));
+    out.close();
+
+    std::cout << "Trajectory " << filename << ": " << frameCount << " frames written, "
+              << getDroppedFrames() << " dropped" << std::endl;
+}
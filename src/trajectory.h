@@ -0,0 +1,200 @@
+//
+// Created by Trebing, Peter on 2019-09-15.
+//
+
+#ifndef COLLISIONSIM_TRAJECTORY_H
+#define COLLISIONSIM_TRAJECTORY_H
+
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "configuration.h"
+#include "simulationObject.h"
+#include "stoppable.h"
+
+/*
+ * Trajectory file layout (all integers in native byte order):
+ *
+ *   TrajectoryHeader
+ *   chunk 0 .. chunk n-1
+ *   TrajectoryIndexEntry[n]
+ *   TrajectoryTrailer
+ *
+ * A chunk stores up to trajectory_chunk_frames consecutive frames of the same particles,
+ * in the same order:
+ *
+ *   TrajectoryChunkHeader
+ *   uint8_t species[particleCount]            (padded to 8 bytes)
+ *   uint64_t step[frameCount]
+ *   column x, column y, column vx, column vy
+ *
+ * Every column holds frameCount * particleCount zig-zag varints, frame after frame. The
+ * values are quantized (1 / resolution pixel resp. pixel per second) and delta encoded
+ * against the previous frame of the same chunk. The first frame of a chunk is encoded
+ * against zero, so every chunk can be decoded on its own. Quantized values are clamped to
+ * int32, the deltas wrap around modulo 2^32.
+ */
+
+const uint32_t TRAJECTORY_COLUMNS = 4;
+
+struct TrajectoryHeader {
+    char magic[8];              // "CSIMTRAJ"
+    uint32_t version;
+    uint32_t byteOrder;         // 0x01020304 written in native byte order
+    uint32_t width;             // size of the box in pixel
+    uint32_t height;
+    uint32_t resolution;        // quantization steps per pixel
+    uint32_t stride;            // physics steps between two frames
+};
+
+struct TrajectoryChunkHeader {
+    char magic[4];              // "CHNK"
+    uint32_t frameCount;
+    uint32_t particleCount;
+    uint32_t reserved;
+    uint64_t firstFrame;        // number of the first frame in the whole trajectory
+    uint64_t columnSize[TRAJECTORY_COLUMNS];
+};
+
+struct TrajectoryIndexEntry {
+    uint64_t offset;            // file offset of the TrajectoryChunkHeader
+    uint64_t firstFrame;
+    uint32_t frameCount;
+    uint32_t particleCount;
+};
+
+struct TrajectoryTrailer {
+    uint64_t indexOffset;
+    uint64_t chunkCount;
+    char magic[8];              // "CSIMTIDX"
+};
+
+/**
+ * Quantized state of all particles at one physics step
+ */
+struct TrajectoryFrame {
+    uint64_t step;
+    std::size_t count;
+    std::vector<int32_t> column[TRAJECTORY_COLUMNS];
+    std::vector<uint8_t> species;
+    std::vector<uint64_t> id;           // of the objects, not written, a new order starts a chunk
+};
+
+/**
+ * Writes trajectories in its own thread. The physics thread records into one of a fixed
+ * number of preallocated frames, encoding and file I/O happen in the writer thread. If
+ * no free frame is available the physics step is not delayed, the frame is dropped.
+ */
+class TrajectoryWriter : public Stoppable {
+
+public:
+
+    static const uint32_t VERSION;
+
+    TrajectoryWriter(Configuration configuration);
+
+    /**
+     * Returns true if a trajectory file is configured
+     */
+    bool isEnabled() const { return !filename.empty(); }
+
+    /**
+     * Encodes and writes recorded frames.
+     * This method is intended to be used in its own thread
+     */
+    void run();
+
+    /**
+     * Returns a free frame to record the given step into, or nullptr if the step is not
+     * due according to the stride or all frames are in use.
+     */
+    TrajectoryFrame *acquire(uint64_t step);
+
+    /**
+     * Sizes the acquired frame for count particles, before they are recorded. Called under
+     * the lock of the particle list, so the count does not change while recording.
+     */
+    void prepare(TrajectoryFrame *frame, std::size_t count) {
+        if (count != frame->count) resize(frame, count);
+    }
+
+    /**
+     * Stores the state of particle i in the prepared frame. Only stores, so the particles
+     * may be recorded by several threads.
+     */
+    void record(TrajectoryFrame *frame, std::size_t i, uint64_t id, const Vector3 &position,
+                const Vector3 &velocity, Species species) {
+        frame->column[0][i] = quantize(position.x);
+        frame->column[1][i] = quantize(position.y);
+        frame->column[2][i] = quantize(velocity.x);
+        frame->column[3][i] = quantize(velocity.y);
+        frame->species[i] = static_cast<uint8_t>(species);
+        frame->id[i] = id;
+    }
+
+    /**
+     * Hands a recorded frame containing count particles over to the writer thread
+     */
+    void submit(TrajectoryFrame *frame, std::size_t count);
+
+    /**
+     * Returns the number of frames which have been dropped to not stall the physics
+     */
+    std::size_t getDroppedFrames() {
+        std::lock_guard<std::mutex> uLock(_mutex);
+        return dropped;
+    }
+
+private:
+
+    static void resize(TrajectoryFrame *frame, std::size_t count);
+
+    /**
+     * Quantizes a coordinate, clamped to int32 (e.g. a molecule heated again and again)
+     */
+    int32_t quantize(double value) const {
+        double quantized = std::round(value * resolution);
+        if (!(quantized > static_cast<double>(INT32_MIN))) return INT32_MIN;     // NaN as well
+        if (quantized > static_cast<double>(INT32_MAX)) return INT32_MAX;
+        return static_cast<int32_t>(quantized);
+    }
+
+    bool open();
+
+    void encode(const TrajectoryFrame &frame);
+
+    void flushChunk();
+
+    void close();
+
+    std::string filename;
+    uint32_t width;
+    uint32_t height;
+    uint32_t resolution;
+    uint32_t stride;
+    std::size_t chunkFrames;
+
+    // frames shared with the physics thread
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<TrajectoryFrame>> frames;
+    std::vector<TrajectoryFrame *> freeFrames;
+    std::deque<TrajectoryFrame *> recordedFrames;
+    std::size_t dropped;
+
+    // state of the writer thread
+    std::ofstream out;
+    std::vector<TrajectoryIndexEntry> index;
+    uint64_t frameCount;
+    std::vector<uint8_t> chunkSpecies;
+    std::vector<uint64_t> chunkIds;
+    std::vector<uint64_t> chunkSteps;
+    std::vector<uint8_t> chunkColumn[TRAJECTORY_COLUMNS];
+    std::vector<int32_t> previous[TRAJECTORY_COLUMNS];
+};
+
+#endif //COLLISIONSIM_TRAJECTORY_H
@@ -0,0 +1,271 @@
+//
+// Created by Trebing, Peter on 2019-09-16.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "trajectoryPlayer.h"
+#include "controller.h"
+#include "renderer.h"
+
+namespace {
+
+// Bytes of the longest varint of 32 bits
+const int MAX_VARINT_BYTES = 5;
+
+/**
+ * Reads one zig-zag encoded varint, see TrajectoryWriter. Corrupt data ends it after
+ * MAX_VARINT_BYTES.
+ */
+inline uint32_t readVarint(const uint8_t *&cursor, const uint8_t *end) {
+    uint32_t value = 0;
+    int shift = 0;
+    for (int bytes = 0; bytes < MAX_VARINT_BYTES && cursor < end; bytes++) {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) break;
+        shift += 7;
+    }
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+// Size of the species column including the padding to 8 bytes
+inline uint64_t speciesSize(uint32_t particleCount) {
+    return particleCount + (8 - particleCount % 8) % 8;
+}
+
+/**
+ * Computes the size of a chunk from its header
+ * @return false, if it is larger than the available bytes
+ */
+bool chunkSize(const TrajectoryChunkHeader &h, uint64_t available, uint64_t &size) {
+    size = sizeof(TrajectoryChunkHeader) + speciesSize(h.particleCount) +
+           static_cast<uint64_t>(h.frameCount) * sizeof(uint64_t);
+    if (size > available) return false;
+    for (uint64_t columnSize: h.columnSize) {
+        if (columnSize > available - size) return false;
+        size += columnSize;
+    }
+    return true;
+}
+
+}
+
+TrajectoryPlayer::TrajectoryPlayer(Configuration configuration) :
+        config(configuration),
+        header(nullptr),
+        frameCount(0),
+        chunk(0),
+        frame(0),
+        chunkHeader(nullptr),
+        species(nullptr),
+        steps(nullptr),
+        cursor{nullptr, nullptr},
+        columnEnd{nullptr, nullptr} {}
+
+bool TrajectoryPlayer::open(const std::string &filename) {
+
+    if (!file.open(filename)) return false;
+
+    if (file.size() < sizeof(TrajectoryHeader)) {
+        std::cerr << filename << " is not a trajectory file.\n";
+        return false;
+    }
+    header = reinterpret_cast<const TrajectoryHeader *>(file.getData());
+    if (std::memcmp(header->magic, "CSIMTRAJ", sizeof(header->magic)) != 0 || header->byteOrder != 0x01020304) {
+        std::cerr << filename << " is not a trajectory file of this platform.\n";
+        return false;
+    }
+    if (header->version != TrajectoryWriter::VERSION) {
+        std::cerr << "Trajectory version " << header->version << " is not supported (expected "
+                  << TrajectoryWriter::VERSION << ").\n";
+        return false;
+    }
+
+    // A trajectory of a crashed run has no index, so its chunks have to be scanned.
+    // A corrupt index is not trusted either.
+    if (!(readIndex() && validIndex()) && !(scanChunks() && validIndex())) {
+        std::cerr << filename << " does not contain any frames.\n";
+        return false;
+    }
+    frameCount = index.back().firstFrame + index.back().frameCount;
+    std::cout << "Trajectory " << filename << ": " << frameCount << " frames in " << index.size()
+              << " chunks" << std::endl;
+    return seek(0);
+}
+
+bool TrajectoryPlayer::readIndex() {
+    if (file.size() < sizeof(TrajectoryHeader) + sizeof(TrajectoryTrailer)) return false;
+    const TrajectoryTrailer *trailer = reinterpret_cast<const TrajectoryTrailer *>(
+            file.getData() + file.size() - sizeof(TrajectoryTrailer));
+    if (std::memcmp(trailer->magic, "CSIMTIDX", sizeof(trailer->magic)) != 0) return false;
+    // the index lies between the header and the trailer, compared without any sum that could wrap
+    uint64_t end = file.size() - sizeof(TrajectoryTrailer);
+    if (trailer->indexOffset < sizeof(TrajectoryHeader) || trailer->indexOffset > end) return false;
+    if (trailer->chunkCount > (end - trailer->indexOffset) / sizeof(TrajectoryIndexEntry)) return false;
+    if (trailer->chunkCount * sizeof(TrajectoryIndexEntry) != end - trailer->indexOffset) return false;
+    const TrajectoryIndexEntry *entries = reinterpret_cast<const TrajectoryIndexEntry *>(
+            file.getData() + trailer->indexOffset);
+    index.assign(entries, entries + trailer->chunkCount);
+    return !index.empty();
+}
+
+bool TrajectoryPlayer::scanChunks() {
+    index.clear();
+    uint64_t offset = sizeof(TrajectoryHeader);
+    while (offset + sizeof(TrajectoryChunkHeader) <= file.size()) {
+        const TrajectoryChunkHeader *h = reinterpret_cast<const TrajectoryChunkHeader *>(file.getData() + offset);
+        if (std::memcmp(h->magic, "CHNK", sizeof(h->magic)) != 0) break;
+        // the last chunk may have been written only partially
+        uint64_t size;
+        if (!chunkSize(*h, file.size() - offset, size)) break;
+        index.push_back(TrajectoryIndexEntry{offset, h->firstFrame, h->frameCount, h->particleCount});
+        offset += size;
+    }
+    return !index.empty();
+}
+
+bool TrajectoryPlayer::validIndex() const {
+    uint64_t next = 0;
+    for (const TrajectoryIndexEntry &entry: index) {
+        if (entry.offset > file.size() || file.size() - entry.offset < sizeof(TrajectoryChunkHeader)) return false;
+        const TrajectoryChunkHeader *h = reinterpret_cast<const TrajectoryChunkHeader *>(file.getData() + entry.offset);
+        uint64_t size;
+        if (std::memcmp(h->magic, "CHNK", sizeof(h->magic)) != 0 || !chunkSize(*h, file.size() - entry.offset, size))
+            return false;
+        if (h->firstFrame != entry.firstFrame || h->frameCount != entry.frameCount ||
+            h->particleCount != entry.particleCount)
+            return false;
+        // the chunks follow each other without gaps, starting at frame 0
+        if (entry.firstFrame != next || entry.frameCount == 0) return false;
+        next += entry.frameCount;
+    }
+    return true;
+}
+
+bool TrajectoryPlayer::seek(uint64_t target) {
+
+    if (target >= frameCount) return false;
+
+    // continue decoding if the target lies ahead within the current chunk
+    bool ahead = chunkHeader != nullptr && chunk < index.size() &&
+                 target >= frame && target < index[chunk].firstFrame + index[chunk].frameCount;
+    if (!ahead) {
+        // binary search for the last chunk starting at or before target
+        auto found = std::upper_bound(index.begin(), index.end(), target,
+                                      [](uint64_t value, const TrajectoryIndexEntry &entry) {
+                                          return value < entry.firstFrame;
+                                      });
+        startChunk(static_cast<std::size_t>(found - index.begin()) - 1);
+        decodeNextFrame();
+    }
+    while (frame < target) decodeNextFrame();
+    return true;
+}
+
+void TrajectoryPlayer::startChunk(std::size_t next) {
+    chunk = next;
+    const char *base = file.getData() + index[chunk].offset;
+    chunkHeader = reinterpret_cast<const TrajectoryChunkHeader *>(base);
+
+    const char *data = base + sizeof(TrajectoryChunkHeader);
+    species = reinterpret_cast<const uint8_t *>(data);
+    data += speciesSize(chunkHeader->particleCount);
+    steps = reinterpret_cast<const uint64_t *>(data);
+    data += chunkHeader->frameCount * sizeof(uint64_t);
+    // only the position columns are needed for rendering, the velocities are skipped
+    cursor[0] = reinterpret_cast<const uint8_t *>(data);
+    columnEnd[0] = cursor[0] + chunkHeader->columnSize[0];
+    cursor[1] = columnEnd[0];
+    columnEnd[1] = cursor[1] + chunkHeader->columnSize[1];
+
+    // the first frame of a chunk is encoded against zero
+    for (auto &column: position) column.assign(chunkHeader->particleCount, 0);
+    frame = chunkHeader->firstFrame - 1;
+}
+
+void TrajectoryPlayer::decodeNextFrame() {
+    for (int c = 0; c < 2; c++) {
+        int32_t *values = position[c].data();
+        for (std::size_t i = 0; i < chunkHeader->particleCount; i++) {
+            // the deltas wrap around modulo 2^32
+            values[i] = static_cast<int32_t>(static_cast<uint32_t>(values[i]) + readVarint(cursor[c], columnEnd[c]));
+        }
+    }
+    ++frame;
+}
+
+TrajectoryFrameView TrajectoryPlayer::getFrame() const {
+    TrajectoryFrameView view;
+    view.frame = frame;
+    view.step = steps[frame - chunkHeader->firstFrame];
+    view.count = chunkHeader->particleCount;
+    view.resolution = header->resolution;
+    view.species = species;
+    view.x = position[0].data();
+    view.y = position[1].data();
+    return view;
+}
+
+void TrajectoryPlayer::Run(Controller &controller, Renderer &renderer, std::size_t target_frame_duration) {
+
+    bool running = true;
+    bool paused = false;
+    double speed = 1.0;
+    double playhead = 0.0;
+    double framesPerSecond = static_cast<double>(config.getReplayFps());
+    KeyState keys = KeyState{};
+
+    std::size_t frame_count = 0;
+
+    std::chrono::time_point<std::chrono::system_clock> lastUpdate;
+    std::chrono::time_point<std::chrono::system_clock> title_timestamp;
+    std::chrono::time_point<std::chrono::system_clock> frame_end;
+
+    // init stop watch
+    lastUpdate = title_timestamp = std::chrono::system_clock::now();
+
+    while (running) {
+
+        // sleep at every iteration to reduce CPU usage
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        // compute time difference to stop watch
+        long timeSinceLastUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now() - lastUpdate).count();
+
+        if (timeSinceLastUpdate >= static_cast<long>(target_frame_duration)) {
+
+            controller.HandleInput(running, keys);
+            if (keys.pause) paused = !paused;
+            if (keys.faster) speed *= 2.0;
+            if (keys.slower) speed *= 0.5;
+            if (keys.forward) playhead += framesPerSecond;
+            if (keys.backward) playhead -= framesPerSecond;
+            keys = KeyState{};
+
+            // advance the playback position by the elapsed time
+            if (!paused) playhead += framesPerSecond * speed * static_cast<double>(timeSinceLastUpdate) / 1000.0;
+            playhead = std::max(0.0, std::min(playhead, static_cast<double>(frameCount - 1)));
+            seek(static_cast<uint64_t>(playhead));
+
+            renderer.render(getFrame());
+
+            frame_count++;
+
+            // After every second, update the window title.
+            frame_end = std::chrono::system_clock::now();
+            long timeSinceLastWindowsUpdate = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    frame_end - title_timestamp).count();
+            if (timeSinceLastWindowsUpdate >= 1000) {
+                renderer.UpdateReplayTitle(getFrame(), frameCount, frame_count, paused ? 0.0 : speed);
+                frame_count = 0;
+                title_timestamp = frame_end;
+            }
+
+            // reset stop watch for next cycle
+            lastUpdate = std::chrono::system_clock::now();
+        }
+    }
+}
@@ -0,0 +1,102 @@
+//
+// Created by Trebing, Peter on 2019-09-16.
+//
+
+#ifndef COLLISIONSIM_TRAJECTORYPLAYER_H
+#define COLLISIONSIM_TRAJECTORYPLAYER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "configuration.h"
+#include "mappedFile.h"
+#include "trajectory.h"
+
+class Controller;
+
+class Renderer;
+
+/**
+ * A single frame of a trajectory as seen by the renderer. Species point directly into
+ * the mapped file, positions into the decode buffers of the player.
+ */
+struct TrajectoryFrameView {
+    uint64_t frame;
+    uint64_t step;
+    std::size_t count;
+    uint32_t resolution;
+    const uint8_t *species;
+    const int32_t *x;
+    const int32_t *y;
+};
+
+/**
+ * Replays a trajectory file written by TrajectoryWriter without any physics. The file is
+ * mapped into memory, frames are located by the chunk index, so seeking never depends
+ * on the length of the trajectory.
+ */
+class TrajectoryPlayer {
+
+public:
+
+    TrajectoryPlayer(Configuration configuration);
+
+    /**
+     * Maps the trajectory file into memory and reads its index
+     * @return false if the file is not a valid trajectory
+     */
+    bool open(const std::string &filename);
+
+    uint64_t getFrameCount() const { return frameCount; }
+
+    /**
+     * Positions the player on the given frame. Moving forward within a chunk only
+     * decodes the frames in between, everything else starts at the beginning of a chunk.
+     */
+    bool seek(uint64_t frame);
+
+    /**
+     * Returns the frame the player is positioned on
+     */
+    TrajectoryFrameView getFrame() const;
+
+    /**
+     * Plays the trajectory until the window is closed. Space pauses, left/right skip
+     * one second back/forward, up/down change the playback speed.
+     */
+    void Run(Controller &controller, Renderer &renderer, std::size_t target_frame_duration);
+
+private:
+
+    bool readIndex();
+
+    bool scanChunks();
+
+    /**
+     * Checks that every chunk of the index lies within the file, matches its header and
+     * that the chunks cover the frames from 0 on without gaps
+     */
+    bool validIndex() const;
+
+    void startChunk(std::size_t chunk);
+
+    void decodeNextFrame();
+
+    Configuration config;
+    MappedFile file;
+    const TrajectoryHeader *header;
+    std::vector<TrajectoryIndexEntry> index;
+    uint64_t frameCount;
+
+    // decode position
+    std::size_t chunk;
+    uint64_t frame;
+    const TrajectoryChunkHeader *chunkHeader;
+    const uint8_t *species;
+    const uint64_t *steps;
+    const uint8_t *cursor[2];
+    const uint8_t *columnEnd[2];
+    std::vector<int32_t> position[2];
+};
+
+#endif //COLLISIONSIM_TRAJECTORYPLAYER_H